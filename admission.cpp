@@ -0,0 +1,92 @@
+#include "admission.hpp"
+
+#include <utility>
+
+Admission::Admission(Options o) : _options{o} {}
+
+Admission::key Admission::key_for(
+    const boost::asio::ip::address& addr) noexcept {
+  if (addr.is_v4())
+    return boost::asio::ip::make_address_v6(boost::asio::ip::v4_mapped,
+                                            addr.to_v4())
+        .to_bytes();
+  return addr.to_v6().to_bytes();
+}
+
+Admission::Shard& Admission::shard_for(const key& k) noexcept {
+  // The low bits go to the map inside the shard; use the high ones here.
+  return shards[(key_hash{}(k) >> 32) % shards.size()];
+}
+
+bool Admission::add_ip(const boost::asio::ip::address& addr) {
+  auto k{key_for(addr)};
+  auto& shard{shard_for(k)};
+  std::scoped_lock lock{shard.mutex};
+  auto& n{shard.counts[k]};
+  if (_options.max_per_ip && n >= _options.max_per_ip) return false;
+  ++n;
+  return true;
+}
+
+void Admission::remove_ip(const boost::asio::ip::address& addr) noexcept {
+  auto k{key_for(addr)};
+  auto& shard{shard_for(k)};
+  std::scoped_lock lock{shard.mutex};
+  if (auto it{shard.counts.find(k)};
+      it != shard.counts.end() && --it->second == 0)
+    shard.counts.erase(it);
+}
+
+Admission::Ticket Admission::admit(const boost::asio::ip::address& addr) {
+  auto n{_connections.fetch_add(1)};
+  if ((!_options.max_connections || n < _options.max_connections) &&
+      add_ip(addr))
+    return {this, addr, verdict_t::admit};
+
+  _connections.fetch_sub(1);
+  if (_options.reply_slow_down) {
+    auto max{_options.max_slow_downs};
+    if (_slowing.fetch_add(1) < max || !max) {
+      _slowed.fetch_add(1, std::memory_order_relaxed);
+      return {this, addr, verdict_t::slow_down};
+    }
+    _slowing.fetch_sub(1);
+  }
+  _refused.fetch_add(1, std::memory_order_relaxed);
+  return {this, addr, verdict_t::refuse};
+}
+
+Admission::Ticket::Ticket(Ticket&& o) noexcept
+    : admission{std::exchange(o.admission, nullptr)},
+      addr{o.addr},
+      _verdict{o._verdict},
+      in_handshake{std::exchange(o.in_handshake, false)} {}
+
+Admission::Ticket::~Ticket() {
+  if (!admission) return;
+  end_handshake();
+  if (_verdict == verdict_t::admit) {
+    admission->_connections.fetch_sub(1);
+    admission->remove_ip(addr);
+  } else if (_verdict == verdict_t::slow_down) {
+    admission->_slowing.fetch_sub(1);
+  }
+}
+
+bool Admission::Ticket::begin_handshake() noexcept {
+  if (_verdict == verdict_t::slow_down) return true;
+  auto max{admission->_options.max_handshakes};
+  if (admission->_handshakes.fetch_add(1) >= max && max) {
+    admission->_handshakes.fetch_sub(1);
+    admission->_refused.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  in_handshake = true;
+  return true;
+}
+
+void Admission::Ticket::end_handshake() noexcept {
+  if (!in_handshake) return;
+  in_handshake = false;
+  admission->_handshakes.fetch_sub(1);
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <boost/asio/ip/address.hpp>
+#include <boost/core/noncopyable.hpp>
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+
+#include "types.hpp"
+
+/**
+ * Admission decides, as each connection is accepted and before any TLS,
+ * whether the server has room for it. Past max_connections, or past
+ * max_per_ip from one address, a connection is told "44 slow down" instead
+ * of being served. Handshakes are the expensive part, so there's a separate
+ * cap on how many run at once; a connection that can't get one is closed
+ * without a word.
+ *
+ * @par
+ * Telling a client to slow down costs a handshake too, so those replies
+ * have a small cap of their own, which covers them from accept to close,
+ * handshake included, and leaves the served connections' handshakes alone.
+ * Past it, a connection over a limit is closed before any TLS.
+ *
+ * @par
+ * Counts are shared by every worker. The totals are atomics, and the
+ * per-address counts are sharded so workers rarely meet on a lock.
+ */
+class Admission : boost::noncopyable {
+ public:
+  struct Options {
+    /// Connections served at once; 0 means no limit.
+    unsigned max_connections{10000};
+    /// TLS handshakes in progress at once; 0 means no limit.
+    unsigned max_handshakes{256};
+    /// Connections served at once from one address; 0 means no limit.
+    unsigned max_per_ip{32};
+    /// When over a limit, reply "44 slow down" (true) or just close.
+    bool reply_slow_down{true};
+    /// Connections being told to slow down at once; 0 means no limit.
+    unsigned max_slow_downs{64};
+    /// What 44 tells clients to wait.
+    std::chrono::seconds retry_after{5};
+  };
+
+  enum class verdict_t { admit, slow_down, refuse };
+
+  /**
+   * A Ticket is one accepted connection's place in the counts; it gives it
+   * back when it's destroyed. Refused connections hold no place.
+   */
+  class Ticket : boost::noncopyable {
+   public:
+    Ticket(Ticket&&) noexcept;
+    ~Ticket();
+
+    verdict_t verdict() const noexcept { return _verdict; }
+
+    /// Take a handshake slot, if there's one free; see end_handshake(). A
+    /// slow_down's is always free: it was taken with the ticket.
+    bool begin_handshake() noexcept;
+    void end_handshake() noexcept;
+
+   private:
+    friend Admission;
+    Ticket(Admission* _admission, boost::asio::ip::address _addr,
+           verdict_t v)
+        : admission{_admission}, addr{_addr}, _verdict{v} {}
+
+    Admission* admission;
+    boost::asio::ip::address addr;
+    verdict_t _verdict;
+    bool in_handshake{};
+  };
+
+  explicit Admission(Options);
+
+  /// Count in a connection from addr, and say what to do with it.
+  Ticket admit(const boost::asio::ip::address& addr);
+
+  const Options& options() const noexcept { return _options; }
+  unsigned connections() const noexcept { return _connections.load(); }
+  unsigned handshakes() const noexcept { return _handshakes.load(); }
+  unsigned slowing() const noexcept { return _slowing.load(); }
+  /// Connections told to slow down, and closed unserved, so far.
+  uint64_t slowed() const noexcept { return _slowed.load(); }
+  uint64_t refused() const noexcept { return _refused.load(); }
+
+ private:
+  using key = array<unsigned char, 16>;
+  struct key_hash {
+    size_t operator()(const key& k) const noexcept {
+      return std::hash<string_view>{}(
+          {reinterpret_cast<const char*>(k.data()), k.size()});
+    }
+  };
+  struct alignas(64) Shard {
+    std::mutex mutex;
+    std::unordered_map<key, unsigned, key_hash> counts;
+  };
+
+  const Options _options;
+  std::atomic<unsigned> _connections{}, _handshakes{}, _slowing{};
+  std::atomic<uint64_t> _slowed{}, _refused{};
+  array<Shard, 16> shards;
+
+  static key key_for(const boost::asio::ip::address&) noexcept;
+  Shard& shard_for(const key&) noexcept;
+  bool add_ip(const boost::asio::ip::address&);
+  void remove_ip(const boost::asio::ip::address&) noexcept;
+};
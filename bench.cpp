@@ -0,0 +1,45 @@
+#include "bench.hpp"
+
+#include <cstdlib>
+#include <new>
+
+std::atomic<size_t> allocations{};
+
+namespace {
+
+void *allocate(size_t sz) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (auto p = std::malloc(sz ? sz : 1); p) return p;
+  throw std::bad_alloc{};
+}
+
+void *allocate(size_t sz, std::align_val_t al) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  auto align = static_cast<size_t>(al);
+  if (auto p = std::aligned_alloc(align, (sz + align - 1) / align * align); p)
+    return p;
+  throw std::bad_alloc{};
+}
+
+}  // namespace
+
+void *operator new(size_t sz) { return allocate(sz); }
+void *operator new[](size_t sz) { return allocate(sz); }
+void *operator new(size_t sz, std::align_val_t al) { return allocate(sz, al); }
+void *operator new[](size_t sz, std::align_val_t al) {
+  return allocate(sz, al);
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept {
+  std::free(p);
+}
+void operator delete[](void *p, size_t, std::align_val_t) noexcept {
+  std::free(p);
+}
+
+BENCHMARK_MAIN();
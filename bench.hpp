@@ -0,0 +1,34 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+#include <openssl/ssl.h>
+
+#include <atomic>
+
+#include "test.hpp"
+#include "types.hpp"
+
+/// Heap allocations made so far by this process. bench.cpp counts them by
+/// replacing operator new.
+extern std::atomic<size_t> allocations;
+
+/**
+ * count_allocations reports how many heap allocations a benchmark made per
+ * iteration, as the "allocs" counter. Declare one just before the benchmark
+ * loop.
+ */
+class count_allocations {
+ public:
+  explicit count_allocations(benchmark::State &s)
+      : state{s}, start{allocations.load(std::memory_order_relaxed)} {}
+
+  ~count_allocations() {
+    state.counters["allocs"] = benchmark::Counter(
+        allocations.load(std::memory_order_relaxed) - start,
+        benchmark::Counter::kAvgIterations);
+  }
+
+ private:
+  benchmark::State &state;
+  size_t start;
+};
@@ -0,0 +1,107 @@
+#include <unistd.h>
+
+#include <cstdio>
+
+#include "bench.hpp"
+#include "body.hpp"
+#include "net-types.hpp"
+#include "response.hpp"
+
+namespace {
+
+// The certificate has to be there before a stream is made from the context,
+// since SSL_new() takes a copy.
+ssl::context server_context() {
+  ssl::context ctx{ssl::context::tlsv13_server};
+  use_ephemeral_cert(ctx.native_handle());
+  return ctx;
+}
+
+/// A TLS connection to ourselves over loopback, handshake already done.
+struct loopback {
+  io_context io{1};
+  ssl::context server_ctx{server_context()};
+  ssl::context client_ctx{ssl::context::tlsv13_client};
+  ssl_socket server{io, server_ctx};
+  ssl::stream<tcp::socket> client{io, client_ctx};
+  BufferPool buffers;
+
+  loopback() {
+    tcp::acceptor a{io, {asio::ip::address_v4::loopback(), 0}};
+    client.next_layer().connect(a.local_endpoint());
+    a.accept(server.next_layer());
+
+    co_spawn(io, server.async_handshake(ssl::stream_base::server), detached);
+    client.async_handshake(ssl::stream_base::client, [](err) {});
+    io.run();
+  }
+
+  /// Run until everything started since the last call finishes.
+  void run() {
+    io.restart();
+    io.run();
+  }
+};
+
+/*
+ * A small page through a real TLS stream, read back by the client side, so
+ * it counts the coroutines, the record encryption and the writes. The header
+ * and body should share one record.
+ */
+void BM_small_page(benchmark::State& state) {
+  loopback l;
+  array<char, 256> buf;
+  constexpr string_view header{"20 text/gemini\r\n"};
+  constexpr string_view body{"# Hello\n\nA small page, like most of them.\n"};
+
+  auto page = [](Response& res) -> awaitable<void> {
+    res.header(Response::code_t::success, "text/gemini");
+    co_await res.write(body);
+    co_await res.finish();
+  };
+
+  count_allocations allocs{state};
+  for (auto _ : state) {
+    Response res{l.server, l.buffers};
+    co_spawn(l.io, page(res), detached);
+    asio::async_read(l.client,
+                     asio::buffer(buf.data(), header.length() + body.length()),
+                     [](err, size_t) {});
+    l.run();
+  }
+}
+BENCHMARK(BM_small_page);
+
+/*
+ * A file body of state.range(0) bytes, pread into the Response's buffer and
+ * written through OpenSSL, read back in full by the client.
+ */
+void BM_file_body(benchmark::State& state) {
+  loopback l;
+  auto size = static_cast<size_t>(state.range(0));
+  auto file{std::tmpfile()};
+  string contents(size, 'x');
+  std::fwrite(contents.data(), 1, size, file);
+  std::fflush(file);
+  constexpr string_view header{"20 text/gemini\r\n"};
+  vector<char> buf(header.length() + size);
+
+  auto page = [](Response& res, int fd) -> awaitable<void> {
+    res.header(Response::code_t::success, "text/gemini");
+    auto body = make_body<FileBody>(res, dup(fd));
+    co_await body->send(res);
+    co_await res.finish();
+  };
+
+  for (auto _ : state) {
+    Response res{l.server, l.buffers};
+    co_spawn(l.io, page(res, fileno(file)), detached);
+    asio::async_read(l.client, asio::buffer(buf), [](err, size_t) {});
+    l.run();
+  }
+  state.SetBytesProcessed(state.iterations() * size);
+  std::fclose(file);
+}
+BENCHMARK(BM_file_body)->Range(1 << 10, 1 << 20);
+
+}  // namespace
@@ -0,0 +1,91 @@
+#include "bench.hpp"
+#include "router.hpp"
+
+namespace {
+
+using path = std::filesystem::path;
+
+/*
+ * The lookup Server::handler_for did before Router, kept here as the
+ * baseline: lower_bound on a std::map keyed by path, then check whether the
+ * key just before it is a parent.
+ */
+std::optional<path> relative_path(const path& parent, const path& child) {
+  auto &p{parent.native()}, &c{child.native()};
+  if (!c.starts_with(p)) {
+    return {};
+  }
+  string_view rest;
+  if (p.ends_with(path::preferred_separator)) {
+    rest = {c.begin() + p.length() - 1, c.end()};
+  } else {
+    rest = {c.begin() + p.length(), c.end()};
+    if (!rest.starts_with(path::preferred_separator)) {
+      return {};
+    }
+  }
+  return path(rest);
+}
+
+std::optional<pair<std::reference_wrapper<const int>, path>> map_lookup(
+    const std::map<path, int>& handlers, const path& p) {
+  auto it = handlers.lower_bound(p);
+  if (it != handlers.end() && it->first == p)
+    return {{std::cref(it->second), path{"/"}}};
+  if (it == handlers.begin()) return {};
+  --it;
+  auto pathinfo = relative_path(it->first, p);
+  if (!pathinfo) return {};
+  return {{std::cref(it->second), *pathinfo}};
+}
+
+/// n mount points at depths 1 to 3, like /c17, /c18/docs, /c19/docs/archive.
+std::map<path, int> make_mounts(int n) {
+  std::map<path, int> mounts;
+  for (int i = 0; i < n; ++i) {
+    string m = "/c" + std::to_string(i);
+    if (i % 3 > 0) m += "/docs";
+    if (i % 3 > 1) m += "/archive";
+    mounts.emplace(m, i);
+  }
+  return mounts;
+}
+
+/// Requests for files somewhere under the mount points, in a scattered order.
+vector<path> make_requests(const std::map<path, int>& mounts) {
+  vector<path> reqs;
+  auto n = mounts.size();
+  for (size_t i = 0; i < 1024; ++i) {
+    auto it = std::next(mounts.begin(), (i * 7919) % n);
+    reqs.push_back(it->first / "notes" / "2022-07-04.gmi");
+  }
+  return reqs;
+}
+
+void BM_map_lookup(benchmark::State& state) {
+  auto mounts = make_mounts(state.range(0));
+  auto reqs = make_requests(mounts);
+  size_t i{};
+  count_allocations allocs{state};
+  for (auto _ : state) {
+    auto m = map_lookup(mounts, reqs[i++ % reqs.size()]);
+    benchmark::DoNotOptimize(m);
+  }
+}
+
+void BM_router(benchmark::State& state) {
+  auto mounts = make_mounts(state.range(0));
+  auto reqs = make_requests(mounts);
+  Router<int> router{mounts};
+  size_t i{};
+  count_allocations allocs{state};
+  for (auto _ : state) {
+    auto m = router.find(reqs[i++ % reqs.size()].native());
+    benchmark::DoNotOptimize(m);
+  }
+}
+
+}  // namespace
+
+BENCHMARK(BM_map_lookup)->Arg(10)->Arg(1000)->Arg(100000);
+BENCHMARK(BM_router)->Arg(10)->Arg(1000)->Arg(100000);
@@ -0,0 +1,86 @@
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <csignal>
+
+#include "bench.hpp"
+#include "server.hpp"
+
+namespace {
+
+constexpr unsigned short port{19650};
+
+int connect_loopback() {
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in sa{};
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons(port);
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::connect(fd, reinterpret_cast<sockaddr *>(&sa), sizeof sa) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/**
+ * A Server on loopback, on its own thread, that answers everything with an
+ * empty page. Resumption is off so every connection does the same work.
+ */
+struct running_server {
+  std::jthread thread;
+
+  running_server() {
+    thread = std::jthread{[] {
+      ssl::context ctx{ssl::context::tlsv13_server};
+      use_ephemeral_cert(ctx.native_handle());
+      Server::Options options;
+      options.endpoint = {asio::ip::address_v4::loopback(), port};
+      options.resumption.mode = Resumption::mode_t::off;
+      Handler empty = [](const Request &,
+                         Response &res) -> awaitable<body_ptr> {
+        res.header(Response::code_t::success, "text/gemini");
+        co_return nullptr;
+      };
+      Server server{std::move(ctx), {{"/", empty}}, options};
+      server.run();
+    }};
+    // Wait until it's listening.
+    int fd;
+    while ((fd = connect_loopback()) < 0) std::this_thread::sleep_for(1ms);
+    close(fd);
+  }
+
+  // Worker 0 shuts the server down on SIGTERM.
+  ~running_server() { std::raise(SIGTERM); }
+};
+
+/*
+ * One whole request per iteration, from accept to close. The client uses
+ * blocking sockets and plain OpenSSL, which allocates with malloc, so "allocs"
+ * counts only what the server side does with operator new.
+ */
+void BM_request(benchmark::State &state) {
+  running_server server;
+  auto ctx = SSL_CTX_new(TLS_client_method());
+  constexpr string_view request{"gemini://localhost/\r\n"};
+  array<char, 256> buf;
+
+  count_allocations allocs{state};
+  for (auto _ : state) {
+    auto fd = connect_loopback();
+    auto ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, fd);
+    SSL_connect(ssl);
+    SSL_write(ssl, request.data(), request.size());
+    while (SSL_read(ssl, buf.data(), buf.size()) > 0) {
+    }
+    SSL_free(ssl);
+    close(fd);
+  }
+  SSL_CTX_free(ctx);
+}
+BENCHMARK(BM_request)->UseRealTime();
+
+}  // namespace
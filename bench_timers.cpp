@@ -0,0 +1,63 @@
+#include <boost/asio/steady_timer.hpp>
+
+#include "bench.hpp"
+#include "net-types.hpp"
+#include "timerwheel.hpp"
+
+namespace {
+
+using namespace std::chrono_literals;
+
+/*
+ * state.range(0) connections, each with a 10 s deadline, moving one of them
+ * along per iteration the way a connection does on every read and write.
+ * This is a steady_timer per connection with a wait always pending, as
+ * Client had before the wheel.
+ */
+void BM_steady_timer_rearm(benchmark::State& state) {
+  io_context io{1};
+  vector<asio::steady_timer> timers;
+  timers.reserve(state.range(0));
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    auto& t{timers.emplace_back(io)};
+    t.expires_after(10s);
+    t.async_wait([](err) {});
+  }
+
+  count_allocations allocs{state};
+  size_t next{};
+  for (auto _ : state) {
+    auto& t{timers[next]};
+    if (++next == timers.size()) next = 0;
+    // Moving the expiry cancels the wait, which has to be replaced.
+    t.expires_after(10s);
+    t.async_wait([](err) {});
+    // Now and then the cancelled waits get to run, as they would.
+    if ((next & 1023) == 0) io.poll();
+  }
+  io.poll();
+}
+BENCHMARK(BM_steady_timer_rearm)->Arg(1000)->Arg(100000);
+
+/// The same, with a TimerWheel::Timer per connection.
+void BM_wheel_rearm(benchmark::State& state) {
+  auto now{TimerWheel::clock::now()};
+  TimerWheel wheel{100ms, now};
+  vector<std::unique_ptr<TimerWheel::Timer>> timers;
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    timers.push_back(std::make_unique<TimerWheel::Timer>(wheel, [] {}));
+    timers.back()->arm(10s);
+  }
+
+  count_allocations allocs{state};
+  size_t next{};
+  for (auto _ : state) {
+    timers[next]->arm(10s);
+    if (++next == timers.size()) next = 0;
+    // Ticks go by as often as the steady_timer loop polls.
+    if ((next & 1023) == 0) wheel.advance(now += 100ms);
+  }
+}
+BENCHMARK(BM_wheel_rearm)->Arg(1000)->Arg(100000);
+
+}  // namespace
@@ -0,0 +1,125 @@
+#include <fstream>
+
+#include "bench.hpp"
+#include "percent.hpp"
+#include "router.hpp"
+#include "uri.hpp"
+
+namespace {
+
+constexpr string_view request{
+    "gemini://example.com/~alice/gemlog/caf%C3%A9/"
+    "2022-07-04.gmi?r%C3%A9sum%C3%A9%20na%C3%AFve"};
+
+/// Request lines from bench_requests.txt, which is read from the current
+/// directory.
+const vector<string>& corpus() {
+  static const auto lines = [] {
+    vector<string> lines;
+    std::ifstream f{"bench_requests.txt"};
+    for (string l; std::getline(f, l);) {
+      if (!l.empty()) lines.push_back(l);
+    }
+    return lines;
+  }();
+  return lines;
+}
+
+void BM_uri(benchmark::State& state) {
+  count_allocations allocs{state};
+  for (auto _ : state) {
+    url::Uri u{request};
+    benchmark::DoNotOptimize(u);
+  }
+}
+BENCHMARK(BM_uri);
+
+void BM_uri_view(benchmark::State& state) {
+  array<char, 1026> buf;
+  count_allocations allocs{state};
+  for (auto _ : state) {
+    std::copy(request.begin(), request.end(), buf.begin());
+    auto u = url::UriView::parse(span{buf}.first(request.length()));
+    benchmark::DoNotOptimize(u);
+  }
+}
+BENCHMARK(BM_uri_view);
+
+void BM_decode(benchmark::State& state, const url::detail::codec* c) {
+  auto in = request.substr(request.find('?') + 1);
+  string out(in.length(), '\0');
+  count_allocations allocs{state};
+  for (auto _ : state) {
+    auto n = c->decode(in, out.data());
+    benchmark::DoNotOptimize(n);
+  }
+  state.SetBytesProcessed(state.iterations() * in.length());
+}
+
+void BM_encode(benchmark::State& state, const url::detail::codec* c) {
+  string in{"résumé naïve 日本語の検索 & other things?"};
+  string out(3 * in.length(), '\0');
+  count_allocations allocs{state};
+  for (auto _ : state) {
+    auto n = c->encode(in, out.data(), url::charset::query);
+    benchmark::DoNotOptimize(n);
+  }
+  state.SetBytesProcessed(state.iterations() * in.length());
+}
+
+[[maybe_unused]] const bool codecs_registered = [] {
+  for (auto& c : url::detail::codecs()) {
+    benchmark::RegisterBenchmark(("BM_decode/"s + c.name).c_str(), BM_decode,
+                                 &c);
+    benchmark::RegisterBenchmark(("BM_encode/"s + c.name).c_str(), BM_encode,
+                                 &c);
+  }
+  return true;
+}();
+
+/*
+ * The corpus benchmarks take one request line per iteration, round robin
+ * through the corpus, so they measure the mix rather than one lucky URL.
+ */
+
+void BM_corpus_uri(benchmark::State& state) {
+  auto& lines = corpus();
+  if (lines.empty()) {
+    state.SkipWithError("bench_requests.txt not found");
+    return;
+  }
+  size_t i{};
+  count_allocations allocs{state};
+  for (auto _ : state) {
+    url::Uri u{lines[i++ % lines.size()]};
+    benchmark::DoNotOptimize(u);
+  }
+}
+BENCHMARK(BM_corpus_uri);
+
+/// What the server does per request: parse in place, then route.
+void BM_corpus_parse_and_route(benchmark::State& state) {
+  auto& lines = corpus();
+  if (lines.empty()) {
+    state.SkipWithError("bench_requests.txt not found");
+    return;
+  }
+  Router<int> router{std::map<std::filesystem::path, int>{
+      {"/", 0}, {"/~alice", 1}, {"/~bob", 2}, {"/docs", 3}, {"/search", 4},
+      {"/cgi-bin", 5}, {"/wiki", 6}, {"/archive", 7}}};
+  array<char, 1026> buf;
+  size_t i{};
+  count_allocations allocs{state};
+  for (auto _ : state) {
+    auto& l = lines[i++ % lines.size()];
+    std::copy(l.begin(), l.end(), buf.begin());
+    auto u = url::UriView::parse(span{buf}.first(l.length()));
+    if (u.index() == 0) {
+      auto m = router.find(std::get<0>(u).path());
+      benchmark::DoNotOptimize(m);
+    }
+  }
+}
+BENCHMARK(BM_corpus_parse_and_route);
+
+}  // namespace
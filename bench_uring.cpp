@@ -0,0 +1,96 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <boost/asio/basic_file.hpp>
+#include <cstdio>
+
+#include "bench.hpp"
+#include "net-types.hpp"
+#include "uring.hpp"
+
+namespace {
+
+using basic_stream_file = asio::basic_stream_file<executor>;
+
+/// A temporary file of n bytes, open for reading.
+struct temp_file {
+  std::FILE* f{std::tmpfile()};
+
+  explicit temp_file(size_t n) {
+    string contents(n, 'x');
+    std::fwrite(contents.data(), 1, n, f);
+    std::fflush(f);
+  }
+  ~temp_file() { std::fclose(f); }
+
+  int fd() const { return fileno(f); }
+};
+
+/*
+ * Reading a whole file, state.range(0) bytes, into a 64 KiB buffer with
+ * basic_stream_file::async_read_some: the loop DirHandler used to run.
+ */
+void BM_read_some(benchmark::State& state) {
+  temp_file t{static_cast<size_t>(state.range(0))};
+  io_context io{1};
+  vector<char> buf(1 << 16);
+
+  auto read_all = [&]() -> awaitable<void> {
+    basic_stream_file f{io, dup(t.fd())};
+    // A dup shares the offset, which the last iteration left at the end.
+    f.seek(0, basic_stream_file::seek_set);
+    for (;;) {
+      err ec;
+      co_await f.async_read_some(asio::buffer(buf),
+                                 asio::redirect_error(asio::use_awaitable, ec));
+      if (ec) co_return;
+    }
+  };
+
+  count_allocations allocs{state};
+  for (auto _ : state) {
+    co_spawn(io, read_all(), detached);
+    io.restart();
+    io.run();
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_read_some)->Range(1 << 12, 1 << 22);
+
+#if CASTOR_URING
+/*
+ * The same through a FileRing: a registered 64 KiB buffer and a slot in the
+ * registered file table, taken and given back each time.
+ */
+void BM_read_fixed(benchmark::State& state) {
+  temp_file t{static_cast<size_t>(state.range(0))};
+  size_t size = state.range(0);
+  io_context io{1};
+  FileRing ring{io, {.enabled = true}};
+  bool done;
+
+  auto read_all = [&]() -> awaitable<void> {
+    auto buf = ring.buffer();
+    auto file = ring.add(t.fd());
+    for (size_t off{}; off < size;)
+      off += co_await ring.read(file, *buf, off, size - off);
+    done = true;
+  };
+
+  count_allocations allocs{state};
+  for (auto _ : state) {
+    done = false;
+    co_spawn(io, read_all(), detached);
+    // The ring always has a read of its own pending, so io never runs out
+    // of work; run until this one's done instead.
+    while (!done) io.run_one();
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+  ring.close();
+  io.restart();
+  io.run();
+}
+BENCHMARK(BM_read_fixed)->Range(1 << 12, 1 << 22);
+#endif
+
+}  // namespace
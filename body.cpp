@@ -0,0 +1,58 @@
+#include "body.hpp"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "probes.hpp"
+#include "uring.hpp"
+
+awaitable<void> SpanBody::send(Response& res) {
+  co_await res.write(asio::buffer(data.data(), data.size()));
+}
+
+awaitable<void> StringBody::send(Response& res) { co_await res.write(data); }
+
+FileBody::~FileBody() { ::close(fd); }
+
+awaitable<void> FileBody::send(Response& res) {
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    throw system_error{err{errno, boost::system::system_category()}, "fstat"};
+  }
+  if (st.st_size == 0) co_return;
+  size_t size = st.st_size;
+
+#if CASTOR_URING
+  if (auto ring = FileRing::local(); ring) {
+    if (auto buf = ring->buffer(); buf) {
+      auto file = ring->add(fd);
+      for (size_t off{}; off < size;) {
+        auto n = co_await ring->read(file, *buf, off, size - off);
+        if (n == 0) break;  // It got shorter.
+        CASTOR_PROBE(file_chunk, res.socket.next_layer().native_handle(), fd,
+                     off, n);
+        co_await res.write(asio::buffer(buf->data(), n));
+        off += n;
+      }
+      co_return;
+    }
+  }
+#endif
+
+  // Read straight into the Response's buffer. Unlike a mapping, a file
+  // truncated under us just comes out short.
+  for (size_t off{}; off < size;) {
+    auto buf = co_await res.prepare();
+    auto n = pread(fd, buf.data(), std::min(buf.size(), size - off), off);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) {
+      throw system_error{err{errno, boost::system::system_category()},
+                         "pread"};
+    }
+    if (n == 0) break;  // It got shorter.
+    CASTOR_PROBE(file_chunk, res.socket.next_layer().native_handle(), fd,
+                 off, n);
+    res.commit(n);
+    off += n;
+  }
+}
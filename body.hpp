@@ -0,0 +1,118 @@
+#pragma once
+
+#include <boost/core/noncopyable.hpp>
+#include <concepts>
+#include <memory>
+#include <memory_resource>
+
+#include "net-types.hpp"
+#include "response.hpp"
+
+/**
+ * Body is what a handler hands back for the server to send after the header.
+ * Each kind knows the cheapest way to get its bytes onto a Response: memory
+ * goes out as is, and files and streams are read straight into the
+ * response's buffer.
+ */
+class Body : boost::noncopyable {
+ public:
+  virtual ~Body() = default;
+
+  /// Write the whole body to res.
+  virtual awaitable<void> send(Response& res) = 0;
+};
+
+/// Destroys a Body made by make_body() and gives its memory back.
+struct body_deleter {
+  std::pmr::memory_resource* mr{};
+  size_t size{};
+
+  void operator()(Body* b) const noexcept {
+    std::destroy_at(b);
+    mr->deallocate(b, size, alignof(std::max_align_t));
+  }
+};
+
+using body_ptr = std::unique_ptr<Body, body_deleter>;
+
+/// Make a B out of res's memory, so it costs the connection's arena, not
+/// malloc.
+template <std::derived_from<Body> B, typename... Args>
+body_ptr make_body(Response& res, Args&&... args) {
+  auto mr{res.memory_resource()};
+  auto p{mr->allocate(sizeof(B), alignof(std::max_align_t))};
+  try {
+    return body_ptr{new (p) B(std::forward<Args>(args)...), {mr, sizeof(B)}};
+  } catch (...) {
+    mr->deallocate(p, sizeof(B), alignof(std::max_align_t));
+    throw;
+  }
+}
+
+/// Bytes owned by someone else. Holding keepalive keeps them around.
+class SpanBody : public Body {
+ public:
+  explicit SpanBody(span<const char> _data,
+                    std::shared_ptr<const void> _keepalive = {})
+      : data{_data}, keepalive{std::move(_keepalive)} {}
+
+  awaitable<void> send(Response& res) override;
+
+ private:
+  span<const char> data;
+  std::shared_ptr<const void> keepalive;
+};
+
+/// Bytes the body owns.
+class StringBody : public Body {
+ public:
+  explicit StringBody(string _data) : data{std::move(_data)} {}
+
+  awaitable<void> send(Response& res) override;
+
+ private:
+  string data;
+};
+
+/**
+ * A regular file. Where the worker has a FileRing, it's read into registered
+ * buffers; otherwise it's pread(2) into the Response's buffer. Either way a
+ * file truncated while it's sent only comes out short; mapping it, as
+ * MapCache does with -m, would be a SIGBUS.
+ */
+class FileBody : public Body {
+ public:
+  /// Takes over fd, which must be open on a regular file.
+  explicit FileBody(int _fd) : fd{_fd} {}
+  ~FileBody() override;
+
+  awaitable<void> send(Response& res) override;
+
+ private:
+  int fd;
+};
+
+/// Anything that meets the AsyncReadStream requirements, read straight into
+/// the Response's buffer until EOF.
+template <typename T>
+  requires requires(T& t, asio::mutable_buffer b) {
+    t.async_read_some(b, asio::use_awaitable);
+  }
+class StreamBody : public Body {
+ public:
+  explicit StreamBody(T&& _stream) : stream{std::move(_stream)} {}
+
+  awaitable<void> send(Response& res) override {
+    for (;;) {
+      err ec;
+      auto n = co_await stream.async_read_some(
+          co_await res.prepare(), asio::redirect_error(asio::use_awaitable, ec));
+      res.commit(n);
+      if (ec == asio::error::eof) co_return;
+      if (ec) throw system_error{ec};
+    }
+  }
+
+ private:
+  T stream;
+};
@@ -0,0 +1,112 @@
+#include "bufferpool.hpp"
+
+#include <boost/asio/post.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/use_awaitable.hpp>
+
+namespace asio = boost::asio;
+
+BufferPool::BufferPool(Options _options) : options{_options} {
+  for (auto& s : shards)
+    for (auto& f : s.free) f.reserve(options.free_per_thread);
+}
+
+BufferPool::~BufferPool() {
+  for (auto& s : shards)
+    for (auto& f : s.free)
+      for (auto p : f) ::operator delete(p);
+}
+
+BufferPool::Shard& BufferPool::local_shard() noexcept {
+  static std::atomic<size_t> next{};
+  thread_local size_t n{next.fetch_add(1, std::memory_order_relaxed)};
+  return shards[n % shard_count];
+}
+
+BufferPool::Buffer BufferPool::try_get(size_t size) {
+  uint8_t cls{};
+  while (cls + 1u < size_classes.size() && size_classes[cls] < size) ++cls;
+  auto n{size_classes[cls]};
+
+  auto before{used.fetch_add(n)};
+  if (before + n > options.cap) {
+    used.fetch_sub(n);
+    return {};
+  }
+  for (auto peak{_peak.load(std::memory_order_relaxed)};
+       before + n > peak && !_peak.compare_exchange_weak(
+                                peak, before + n, std::memory_order_relaxed);)
+    ;
+
+  auto& shard{local_shard()};
+  {
+    std::scoped_lock lock{shard.mutex};
+    if (auto& f{shard.free[cls]}; !f.empty()) {
+      auto p{f.back()};
+      f.pop_back();
+      return {this, p, cls};
+    }
+  }
+  return {this, static_cast<char*>(::operator new(n)), cls};
+}
+
+void BufferPool::put(char* p, uint8_t cls) noexcept {
+  auto& shard{local_shard()};
+  {
+    std::scoped_lock lock{shard.mutex};
+    if (auto& f{shard.free[cls]}; f.size() < f.capacity())
+      f.push_back(p);
+    else
+      ::operator delete(p);
+  }
+  used.fetch_sub(size_classes[cls]);
+
+  if (waiting.load() == 0) return;
+  waiter w;
+  {
+    std::scoped_lock lock{waiters_mutex};
+    if (waiters.empty()) return;
+    w = std::move(waiters.front());
+    waiters.pop_front();
+    waiting.fetch_sub(1);
+  }
+  // The timer belongs to the waiter's thread, so cancel it there.
+  asio::post(w->get_executor(), [w] { w->cancel(); });
+}
+
+bool BufferPool::forget(const waiter& w) noexcept {
+  std::scoped_lock lock{waiters_mutex};
+  auto it{std::find(waiters.begin(), waiters.end(), w)};
+  if (it == waiters.end()) return false;
+  waiters.erase(it);
+  waiting.fetch_sub(1);
+  return true;
+}
+
+asio::awaitable<BufferPool::Buffer> BufferPool::get(size_t size) {
+  if (auto b{try_get(size)}; b) co_return b;
+  _waits.fetch_add(1, std::memory_order_relaxed);
+
+  auto w{std::make_shared<asio::steady_timer>(
+      co_await asio::this_coro::executor)};
+  for (;;) {
+    // Queue up before looking again, so a put() in between either leaves
+    // enough room for the second look or wakes us. Look again now and then
+    // anyway, in case a wakeup went to someone who didn't need it.
+    w->expires_after(std::chrono::milliseconds{100});
+    {
+      std::scoped_lock lock{waiters_mutex};
+      waiters.push_back(w);
+      waiting.fetch_add(1);
+    }
+    if (auto b{try_get(size)}; b) {
+      forget(w);
+      co_return b;
+    }
+    boost::system::error_code ec;
+    co_await w->async_wait(asio::redirect_error(asio::use_awaitable, ec));
+    forget(w);
+    if (auto b{try_get(size)}; b) co_return b;
+  }
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+// Ahead of asio: some versions' awaitable.hpp use std::exchange without it.
+#include <utility>
+
+#include <atomic>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/core/noncopyable.hpp>
+#include <deque>
+#include <mutex>
+
+#include "types.hpp"
+
+/**
+ * BufferPool lends out I/O buffers for as long as a write needs them, so
+ * memory follows the number of transfers in flight, not the number of
+ * connections. Buffers come in a few size classes. Returned ones go on a
+ * free list for the thread that returned them, and the next borrower on that
+ * thread gets one back without touching malloc.
+ *
+ * @par
+ * At most cap bytes are out at once. try_get() fails past that; get() waits
+ * until enough come back, which slows writers down instead of growing
+ * without bound.
+ */
+class BufferPool : boost::noncopyable {
+ public:
+  static constexpr array<size_t, 3> size_classes{1 << 12, 1 << 14, 1 << 16};
+
+  struct Options {
+    /// Most bytes lent out at once.
+    size_t cap{64 << 20};
+    /// Most buffers of each class kept on each thread's free list.
+    size_t free_per_thread{64};
+  };
+
+  /// A borrowed buffer, given back when it's destroyed.
+  class Buffer {
+   public:
+    Buffer() = default;
+    Buffer(Buffer&& o) noexcept
+        : pool{std::exchange(o.pool, nullptr)}, p{o.p}, cls{o.cls} {}
+    Buffer& operator=(Buffer&& o) noexcept {
+      std::swap(pool, o.pool);
+      std::swap(p, o.p);
+      std::swap(cls, o.cls);
+      return *this;
+    }
+    ~Buffer() {
+      if (pool) pool->put(p, cls);
+    }
+
+    char* data() const noexcept { return p; }
+    size_t size() const noexcept { return pool ? size_classes[cls] : 0; }
+    explicit operator bool() const noexcept { return pool; }
+
+   private:
+    friend BufferPool;
+    Buffer(BufferPool* _pool, char* _p, uint8_t _cls)
+        : pool{_pool}, p{_p}, cls{_cls} {}
+
+    BufferPool* pool{};
+    char* p{};
+    uint8_t cls{};
+  };
+
+  explicit BufferPool(Options);
+  BufferPool() : BufferPool{Options{}} {}
+  ~BufferPool();
+
+  /// A buffer of at least size bytes (at most the largest class), or an
+  /// empty one if lending it would go over the cap.
+  Buffer try_get(size_t size);
+
+  /// Like try_get(), but waits for buffers to come back instead of failing.
+  boost::asio::awaitable<Buffer> get(size_t size);
+
+  /// Bytes lent out right now.
+  size_t in_use() const noexcept { return used.load(std::memory_order_relaxed); }
+  /// Most bytes ever lent out at once.
+  size_t peak() const noexcept { return _peak.load(std::memory_order_relaxed); }
+  /// How many times get() had to wait.
+  uint64_t waits() const noexcept {
+    return _waits.load(std::memory_order_relaxed);
+  }
+
+ private:
+  // A thread's free lists. Threads are spread over shards by a number
+  // they're given the first time they touch any pool, so with no more
+  // threads than shards each has its own and the lock is never contended.
+  struct alignas(64) Shard {
+    std::mutex mutex;
+    array<vector<char*>, size_classes.size()> free;
+  };
+  static constexpr size_t shard_count{64};
+
+  const Options options;
+  array<Shard, shard_count> shards;
+  std::atomic<size_t> used{}, _peak{};
+  std::atomic<uint64_t> _waits{};
+
+  // Coroutines in get(), each parked on a timer that put() cancels.
+  using waiter = std::shared_ptr<boost::asio::steady_timer>;
+  std::mutex waiters_mutex;
+  std::deque<waiter> waiters;
+  std::atomic<size_t> waiting{};
+
+  Shard& local_shard() noexcept;
+  void put(char* p, uint8_t cls) noexcept;
+  bool forget(const waiter&) noexcept;
+};
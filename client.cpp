@@ -2,58 +2,109 @@
 
 #include <variant>
 
+#include "log.hpp"
 #include "openssl.hpp"
+#include "probes.hpp"
 #include "response.hpp"
 #include "uri.hpp"
 
 // Either a Request or an explanation why it couldn't parse.
 using MaybeReq = std::variant<Request, string_view>;
 
-awaitable<MaybeReq> parse_request(ssl_socket &peer) {
+/**
+ * parse_request(peer, buf) reads a request line into buf and parses it in
+ * place. The Request views into buf. Each explanation has a line in
+ * Response::canned_headers.
+ */
+awaitable<MaybeReq> parse_request(ssl_socket &peer, span<char> buf) {
   try {
-    string b;
-    auto sz =
-        co_await async_read_until(peer, asio::dynamic_buffer(b, 1026), "\r\n");
-    b.erase(b.end() - 2, b.end());
-    url::Uri u{string_view{b.begin(), b.begin() + sz - 2}};
+    size_t sz{}, eol;
+    for (;;) {
+      if (sz == buf.size()) co_return "Missing CRLF.";
+      sz += co_await peer.async_read_some(
+          asio::buffer(buf.data() + sz, buf.size() - sz));
+      if (eol = string_view{buf.data(), sz}.find("\r\n");
+          eol != string_view::npos)
+        break;
+    }
+
+    auto maybeUri = url::UriView::parse(buf.first(eol));
+    if (maybeUri.index() == 1) {
+      co_return "Request is malformed.";
+    }
+    auto &u = std::get<0>(maybeUri);
 
     if (u.scheme() != "gemini") {
       co_return "URL must start with 'gemini:'";
     }
 
-    if (!u.path().is_absolute()) {
+    if (!u.path().starts_with('/')) {
       co_return "URL must be absolute.";
     }
 
-    co_return Request{std::move(u)};
+    co_return Request{u};
   } catch (const system_error &e) {
-    switch (e.code().value()) {
-      case asio::error::not_found:
-        co_return "Missing CRLF.";
-        break;
-      default:
-        cout << peer.lowest_layer().remote_endpoint() << " system_error"
-             << e.code().value() << endl;
-        co_return "Request is malformed.";
-        break;
-    }
-  } catch (const std::logic_error &e) {
+    err ec;
+    logging::log(logging::level::debug, peer.lowest_layer().remote_endpoint(ec),
+                 "system_error ", e.code().value());
     co_return "Request is malformed.";
   }
 }
 
-Client::Client(Server &_server, ssl_socket &&_peer)
+Client::Client(Server &_server, ssl_socket &&_peer,
+               Admission::Ticket &&_ticket, TimerWheel &wheel)
     : server{_server},
       peer{std::move(_peer)},
-      _timeout{peer.get_executor(), 10s} {}
+      ticket{std::move(_ticket)},
+      deadline{wheel, [this] {
+                 err ec;
+                 logging::log(logging::level::info,
+                              peer.next_layer().remote_endpoint(ec),
+                              "Timed out: ", trace.phase());
+                 cancel.emit(asio::cancellation_type::terminal);
+               }} {
+  trace.mark(phase_t::accept);
+  trace.worker = static_cast<uint8_t>(metrics.id);
+  auto every{server.tracing().every};
+  sampled = server.traces().enabled() && every &&
+            metrics.accepted.value() % every == 0;
+}
+
+Client::~Client() {
+  CASTOR_PROBE(close, peer.next_layer().native_handle(), trace.status);
+  trace.end();
+  metrics.record(trace);
+  metrics.closed.add();
+  if (sampled) server.traces().offer(trace);
+}
 
 awaitable<void> Client::run() {
+  auto start = std::chrono::steady_clock::now();
   auto ip = peer.next_layer().remote_endpoint();
-  cout << ip << " Connected" << '\n';
+  auto &timeouts = server.timeouts();
+  logging::log(logging::level::debug, ip, "Connected");
+
+  if (!ticket.begin_handshake()) {
+    logging::log(logging::level::debug, ip, "Too many handshakes; closing");
+    co_return;
+  }
+  trace.mark(phase_t::handshake);
 
   try {
-    co_await peer.async_handshake(ssl::stream_base::server);
+    deadline.arm(timeouts.handshake);
+    CASTOR_PROBE(handshake_start, peer.next_layer().native_handle());
+    try {
+      co_await peer.async_handshake(ssl::stream_base::server);
+    } catch (const system_error &) {
+      CASTOR_PROBE(handshake_end, peer.next_layer().native_handle(), 0);
+      metrics.handshake_failures.add();
+      throw;
+    }
+    CASTOR_PROBE(handshake_end, peer.next_layer().native_handle(), 1);
+    ticket.end_handshake();
+    server.resumption().handshake_done(peer.native_handle());
     string serverName;
+    Response res{peer, server.buffers(), &arena};
 
     {
       openssl::Ssl ssl{peer.native_handle()};
@@ -63,35 +114,75 @@ awaitable<void> Client::run() {
         if (auto cstr{session.hostname()}; cstr) serverName = cstr;
     }
 
-    Response res{peer};
-    auto maybeReq = co_await parse_request(peer);
-    if (maybeReq.index() == 0) {
-      auto req = std::get<0>(maybeReq);
-      auto h = server.handler_for(req.uri.path());
+    trace.mark(phase_t::request);
+    deadline.arm(timeouts.request);
+    auto maybeReq = co_await parse_request(peer, request_buf);
+
+    // From here the response has first_byte to get going, then idle_write
+    // between writes, however long it takes overall.
+    trace.mark(phase_t::route);
+    deadline.arm(timeouts.first_byte);
+    res.deadline = &deadline;
+    res.idle_write = timeouts.idle_write;
+
+    string_view path{"-"};
+    const Server::Mount *mount{};
+    if (ticket.verdict() == Admission::verdict_t::slow_down) {
+      // Read the request anyway: closing on unread data would reset the
+      // connection, and the client might never see the reply.
+      trace.mark(phase_t::handler);
+      array<char, 20> retry;
+      auto end = std::to_chars(
+          retry.begin(), retry.end(),
+          server.admission().options().retry_after.count()).ptr;
+      res.header(Response::code_t::slow_down, {retry.data(), end});
+    } else if (maybeReq.index() == 0) {
+      auto &req = std::get<0>(maybeReq);
+      path = req.uri.path();
+      CASTOR_PROBE(request, peer.next_layer().native_handle(), path.data(),
+                   path.size());
+      auto h = server.handler_for(serverName, req.uri.path());
+      trace.mark(phase_t::handler);
       if (h) {
-        req.path_info = h->second;
-        co_await h->first(req, res);
+        req.path_info = h->path_info;
+        mount = &h->value.get();
+        if (auto body = co_await mount->handler(req, res); body)
+          co_await body->send(res);
       } else {
         res.header(Response::code_t::not_found, "Not found.");
       }
     } else {
+      trace.mark(phase_t::handler);
       res.header(Response::code_t::bad_request, std::get<1>(maybeReq));
     }
 
-    co_await res.flush_header();
-
-    cout << ip << ' ' << static_cast<int>(res.code) << ' ' << res.meta << '\n';
+    co_await res.finish();
+
+    trace.mark(phase_t::shutdown);
+    trace.status = static_cast<int>(res.code);
+    trace.path(path);
+    if (mount)
+      metrics.handler_latency[mount->id].record(
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              trace.duration(phase_t::handler))
+              .count());
+    if (auto c = static_cast<size_t>(res.code); c < metrics.responses.size())
+      metrics.responses[c].add();
+    metrics.bytes_sent.add(res.bytes_sent());
+
+    logging::access(ip, static_cast<int>(res.code),
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        trace.marks[static_cast<size_t>(phase_t::shutdown)] -
+                        start),
+                    path, ' ', res.meta);
   } catch (const std::exception &e) {
-    cout << ip << " Error: " << typeid(e).name() << ' ' << e.what() << '\n';
+    logging::log(logging::level::warning, ip, "Error: ", typeid(e).name(), ' ',
+                 e.what());
   }
 
-  cout << "Closing " << ip << '\n';
+  logging::log(logging::level::debug, ip, "Closing");
+  trace.mark(phase_t::shutdown);
+  deadline.arm(timeouts.idle_write);
   co_await peer.async_shutdown();
 }
 
-awaitable<void> Client::timeout() { co_await _timeout.async_wait(); }
-
-void Client::close() {
-  _timeout.cancel();
-  peer.lowest_layer().close();
-}
\ No newline at end of file
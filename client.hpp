@@ -2,21 +2,52 @@
 
 class Client;
 
+#include <boost/intrusive/list_hook.hpp>
+
+/// Links a Client into its Worker's list; unlinks itself when destroyed.
+using client_hook = boost::intrusive::list_base_hook<
+    boost::intrusive::link_mode<boost::intrusive::auto_unlink>>;
+
+#include "metrics.hpp"
 #include "net-types.hpp"
 #include "server.hpp"
+#include "timerwheel.hpp"
+#include "trace.hpp"
 
 #include <boost/core/noncopyable.hpp>
+#include <memory_resource>
 
-class Client : boost::noncopyable {
+/**
+ * Client is one connection. Everything it needs lives inside it, so it comes
+ * and goes in one allocation; the hook puts it on its Worker's list of open
+ * connections without allocating either.
+ */
+class Client : boost::noncopyable, public client_hook {
  public:
-  Client(Server &, ssl_socket &&);
+  Client(Server &, ssl_socket &&, Admission::Ticket &&, TimerWheel &);
+  ~Client();
 
   awaitable<void> run();
-  awaitable<void> timeout();
-  void close();
+
+  /// Emitting this cancels run(). Missing a deadline emits it.
+  asio::cancellation_signal cancel;
 
  private:
   Server &server;
+  // The accepting worker's; see Worker::do_run.
+  Metrics::Shard &metrics{*Metrics::local()};
+  Trace trace;
+  // Whether trace goes to SlowTraces.
+  bool sampled{};
   ssl_socket peer;
-  timer _timeout;
+  Admission::Ticket ticket;
+  // One deadline, moved along as the connection goes from phase to phase.
+  TimerWheel::Timer deadline;
+  // A request line is at most 1024 bytes of URL plus CRLF.
+  array<char, 1026> request_buf;
+  // For the rest of what the connection allocates, like Response::meta.
+  // Nothing is freed until the Client is.
+  array<std::byte, 1024> arena_buf;
+  std::pmr::monotonic_buffer_resource arena{arena_buf.data(),
+                                            arena_buf.size()};
 };
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "body.hpp"
 #include "net-types.hpp"
 #include "request.hpp"
 #include "response.hpp"
@@ -9,4 +10,9 @@ concept HandlerFunc = std::default_initializable<T> && std::movable<T> && requir
   { t(r) } -> std::same_as<void>;
 };
 
-using Handler = std::function<awaitable<void>(const Request&, Response&)>;
+/**
+ * A Handler sets the header on the Response and returns the Body, if any; the
+ * Client sends it. Make bodies with make_body(). A handler that wrote
+ * everything itself returns nullptr.
+ */
+using Handler = std::function<awaitable<body_ptr>(const Request&, Response&)>;
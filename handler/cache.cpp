@@ -0,0 +1,161 @@
+#include "cache.hpp"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+namespace {
+
+constexpr uint32_t watch_mask = IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB |
+                                IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+
+[[noreturn]] void throw_errno(const char* what) {
+  throw std::system_error{errno, std::system_category(), what};
+}
+
+string key_for(const std::filesystem::path& p) {
+  return p.lexically_normal().native();
+}
+
+}  // namespace
+
+FileCache::FileCache(const vector<std::filesystem::path>& roots,
+                     size_t _capacity)
+    : capacity{_capacity}, entries{_capacity} {
+  inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd < 0) throw_errno("inotify_init1");
+  wake_fd = eventfd(0, EFD_CLOEXEC);
+  if (wake_fd < 0) {
+    close(inotify_fd);
+    throw_errno("eventfd");
+  }
+
+  for (auto& root : roots) watch_tree(root);
+  watcher = std::thread{&FileCache::watch, this};
+}
+
+FileCache::~FileCache() {
+  uint64_t one{1};
+  if (write(wake_fd, &one, sizeof one) == sizeof one) watcher.join();
+  else watcher.detach();
+  close(wake_fd);
+  close(inotify_fd);
+}
+
+FileCache::entry_ptr FileCache::find(const std::filesystem::path& p) {
+  return entries.find(key_for(p)).value_or(nullptr);
+}
+
+FileCache::entry_ptr FileCache::load(const std::filesystem::path& p, int fd,
+                                     string_view header) {
+  auto gen{generation.load()};
+
+  struct stat st;
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+      static_cast<size_t>(st.st_size) > max_file_size())
+    return {};
+
+  auto entry = std::make_shared<Entry>();
+  entry->header_length = header.length();
+  entry->data.resize(header.length() + st.st_size);
+  std::copy(header.begin(), header.end(), entry->data.begin());
+
+  for (off_t off{}; off < st.st_size;) {
+    auto n = pread(fd, &entry->data[header.length() + off], st.st_size - off,
+                   off);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return {};
+    off += n;
+  }
+
+  // Something changed while we were reading; don't cache what might be a
+  // stale copy. This caller can still use it.
+  if (gen != generation.load()) return entry;
+  auto key = key_for(p);
+  entries.insert(key, entry, entry->data.size());
+  // An invalidation bumps the generation before it erases, so if one came
+  // in since the check above, either it erased this or we do.
+  if (gen != generation.load()) entries.erase(key);
+  return entry;
+}
+
+void FileCache::watch_tree(const std::filesystem::path& dir) {
+  auto add = [&](const std::filesystem::path& d) {
+    auto wd = inotify_add_watch(inotify_fd, d.c_str(), watch_mask);
+    if (wd >= 0) watches[wd] = d;
+  };
+
+  std::error_code ec;
+  if (!std::filesystem::is_directory(dir, ec)) return;
+  add(dir);
+  for (auto it = std::filesystem::recursive_directory_iterator{dir, ec};
+       it != std::filesystem::recursive_directory_iterator{};
+       it.increment(ec)) {
+    if (ec) break;
+    if (it->is_directory(ec)) add(it->path());
+  }
+}
+
+void FileCache::watch() {
+  alignas(inotify_event) char buf[4096];
+  array<pollfd, 2> fds{{{inotify_fd, POLLIN, 0}, {wake_fd, POLLIN, 0}}};
+
+  for (;;) {
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR) continue;
+      cerr << "FileCache: poll: " << std::strerror(errno) << '\n';
+      clear();
+      return;
+    }
+    if (fds[1].revents) return;
+
+    auto len = read(inotify_fd, buf, sizeof buf);
+    if (len <= 0) continue;
+
+    for (char* p = buf; p < buf + len;) {
+      auto ev = reinterpret_cast<const inotify_event*>(p);
+      p += sizeof(inotify_event) + ev->len;
+
+      if (ev->mask & IN_Q_OVERFLOW) {
+        clear();
+        continue;
+      }
+
+      auto dir = watches.find(ev->wd);
+      if (dir == watches.end()) continue;
+
+      if (ev->mask & IN_IGNORED) {
+        watches.erase(dir);
+        continue;
+      }
+
+      if (ev->mask & IN_ISDIR) {
+        // A whole subtree came or went. Rather than work out which entries
+        // live under it, start over.
+        clear();
+        if (ev->mask & (IN_CREATE | IN_MOVED_TO))
+          watch_tree(dir->second / ev->name);
+        continue;
+      }
+
+      if (ev->len > 0) invalidate(dir->second / ev->name);
+    }
+  }
+}
+
+void FileCache::invalidate(const std::filesystem::path& p) {
+  ++generation;
+  entries.erase(key_for(p));
+}
+
+void FileCache::clear() {
+  ++generation;
+  entries.clear();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <boost/core/noncopyable.hpp>
+#include <filesystem>
+#include <thread>
+#include <unordered_map>
+
+#include "../lru.hpp"
+#include "../types.hpp"
+
+/**
+ * FileCache keeps the complete responses for small, hot files in memory:
+ * the header line followed by the file contents, in one contiguous buffer
+ * that can go out in a single write.
+ *
+ * @par
+ * It holds at most capacity bytes and evicts the least recently used entries
+ * to make room, in shards with a lock each, so workers rarely meet on a hit.
+ * A background thread watches the directory trees under roots with inotify
+ * and drops entries whose files change. Entries are keyed by path, so
+ * several directories can share one cache, and its capacity, as long as
+ * they're looked up the same way they're watched, e.g. by absolute path.
+ * It's safe to use from any thread.
+ */
+class FileCache : boost::noncopyable {
+ public:
+  struct Entry {
+    /// Header line and body.
+    string data;
+    /// Length of the header line at the front of data.
+    size_t header_length;
+  };
+  using entry_ptr = std::shared_ptr<const Entry>;
+
+  FileCache(const vector<std::filesystem::path>& roots, size_t capacity);
+  ~FileCache();
+
+  /// Look up the entry for the file at p, or nullptr.
+  entry_ptr find(const std::filesystem::path& p);
+
+  /**
+   * load(p, fd, header) reads the file open at fd (whose path is p) into a
+   * new entry starting with header. Returns nullptr if the file is too large
+   * to cache.
+   */
+  entry_ptr load(const std::filesystem::path& p, int fd, string_view header);
+
+  /// Largest file that will be cached: a quarter of a shard.
+  size_t max_file_size() const noexcept {
+    return entries_t::shard_capacity(capacity) / 4;
+  }
+
+ private:
+  using entries_t = ShardedLru<entry_ptr, 8>;
+
+  const size_t capacity;
+  // Each entry costs its size.
+  entries_t entries;
+  // Bumped before every invalidation, so load() can tell if the file changed
+  // while it was reading it.
+  std::atomic<uint64_t> generation{};
+
+  int inotify_fd{-1}, wake_fd{-1};
+  std::unordered_map<int, std::filesystem::path> watches;
+  std::thread watcher;
+
+  void watch_tree(const std::filesystem::path&);
+  void watch();
+  void invalidate(const std::filesystem::path&);
+  void clear();
+};
@@ -1,51 +1,78 @@
 #include "dir.hpp"
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <boost/asio/basic_file.hpp>
 
-using basic_stream_file = asio::basic_stream_file<executor>;
+#include "../log.hpp"
+
+#if defined(BOOST_ASIO_HAS_FILE)
+using stream_file = asio::basic_stream_file<executor>;
+#else
+// Asio's files need io_uring; without it a pipe is read like a socket.
+using stream_file = asio::posix::basic_stream_descriptor<executor>;
+#endif
+
+DirHandler::DirHandler(std::filesystem::path p,
+                       std::shared_ptr<FileCache> _cache,
+                       std::shared_ptr<MapCache> _maps)
+    : root{std::filesystem::absolute(p).lexically_normal()},
+      cache{std::move(_cache)},
+      maps{std::move(_maps)} {}
 
-DirHandler::DirHandler(std::filesystem::path p) : root{p} {}
+awaitable<body_ptr> DirHandler::operator()(const Request &req,
+                                           Response &res) {
+  auto child = root / req.path_info.substr(1);
+  logging::log(logging::level::debug, "Serving ", child.native());
+
+  // Only regular files are ever cached, so a hit means no redirect either.
+  if (cache) {
+    auto entry =
+        cache->find(child.has_filename() ? child : child / "index.gmi");
+    if (entry) {
+      res.header(Response::code_t::success, "text/gemini");
+      co_await res.flush_prebuilt(asio::buffer(entry->data));
+      co_return nullptr;
+    }
+  }
 
-awaitable<void> DirHandler::operator()(const Request &req, Response &res) {
-  auto child = root / req.path_info.relative_path();
-  cout << child << '\n';
-  if (std::filesystem::is_directory(child) && req.uri.path().has_filename()) {
-    auto dirpath = req.uri.path() / "";
-    auto redirect = string(url::Uri{dirpath.native(), req.uri});
+  if (std::filesystem::is_directory(child) && !req.uri.path().ends_with('/')) {
+    auto dirpath = string{req.uri.path()} + '/';
+    auto redirect = string(url::Uri{dirpath, url::Uri{req.uri}});
     res.header(Response::code_t::redirect_permanent, redirect);
-    co_return;
+    co_return nullptr;
   }
 
   if (!child.has_filename()) child /= "index.gmi";
 
-  basic_stream_file f{res.socket.get_executor()};
-  try {
-    f.open(child, basic_stream_file::read_only);
-    res.header(Response::code_t::success, "text/gemini");
-  } catch (const system_error &e) {
+  if (maps) {
+    if (auto m = maps->map(child); m) {
+      res.header(Response::code_t::success, "text/gemini");
+      co_return make_body<SpanBody>(res, m->bytes(), m);
+    }
+  }
+
+  int fd = ::open(child.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) < 0 || S_ISDIR(st.st_mode)) {
+    if (fd >= 0) ::close(fd);
     res.header(Response::code_t::not_found, "Not found.");
-    co_return;
+    co_return nullptr;
   }
+  res.header(Response::code_t::success, "text/gemini");
 
-  co_await res.flush_header();
-
-  if (f.is_open()) {
-    array<char, (1 << 18)> array;
-    auto buf = asio::mutable_buffer{array.begin(), array.size()};
-    try {
-      for (;;) {
-        auto sz = co_await f.async_read_some(buf, asio::use_awaitable);
-        if (sz > 0)
-          co_await async_write(res.socket,
-                               asio::const_buffer{array.begin(), sz});
-      }
-    } catch (const system_error &e) {
-      if (e.code() != asio::error::eof) {
-        throw;
-      }
-    } catch (const std::exception &e) {
-      cerr << "Exception serving file: " << e.what() << '\n';
+  if (cache) {
+    if (auto entry = cache->load(child, fd, res.header_line()); entry) {
+      ::close(fd);
+      co_await res.flush_prebuilt(asio::buffer(entry->data));
+      co_return nullptr;
     }
-    f.close();
   }
-}
\ No newline at end of file
+
+  if (S_ISREG(st.st_mode)) co_return make_body<FileBody>(res, fd);
+  // Pipes and the like can't be pread.
+  co_return make_body<StreamBody<stream_file>>(
+      res, stream_file{res.socket.get_executor(), fd});
+}
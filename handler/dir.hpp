@@ -1,15 +1,26 @@
 #pragma once
 
 #include "../handler.hpp"
+#include "cache.hpp"
+#include "mapcache.hpp"
 
 #include <filesystem>
 
 class DirHandler {
  public:
-  DirHandler(std::filesystem::path);
+  /// Serve files under root. With a cache, small files' responses are kept
+  /// in it, which has to be watching root; with maps, files are kept mapped
+  /// and sent from the mapping. Either can be shared between DirHandlers,
+  /// since files are looked up by absolute path.
+  explicit DirHandler(std::filesystem::path root,
+                      std::shared_ptr<FileCache> cache = {},
+                      std::shared_ptr<MapCache> maps = {});
 
-  awaitable<void> operator()(const Request&, Response&);
+  awaitable<body_ptr> operator()(const Request&, Response&);
 
  private:
   std::filesystem::path root;
+  // Shared, since Handler copies us around, and between hosts.
+  std::shared_ptr<FileCache> cache;
+  std::shared_ptr<MapCache> maps;
 };
\ No newline at end of file
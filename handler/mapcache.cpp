@@ -0,0 +1,55 @@
+#include "mapcache.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+MapCache::Mapping::Mapping(void* _data, const struct stat& st)
+    : data{static_cast<const char*>(_data)},
+      size{static_cast<size_t>(st.st_size)},
+      dev{st.st_dev},
+      ino{st.st_ino},
+      mtime{st.st_mtim} {}
+
+MapCache::Mapping::~Mapping() {
+  if (size > 0) munmap(const_cast<char*>(data), size);
+}
+
+bool MapCache::Mapping::matches(const struct stat& st) const noexcept {
+  return st.st_dev == dev && st.st_ino == ino &&
+         static_cast<size_t>(st.st_size) == size &&
+         st.st_mtim.tv_sec == mtime.tv_sec &&
+         st.st_mtim.tv_nsec == mtime.tv_nsec;
+}
+
+MapCache::mapping_ptr MapCache::map(const std::filesystem::path& p) {
+  auto key = p.lexically_normal().native();
+
+  struct stat st;
+  if (stat(key.c_str(), &st) < 0 || !S_ISREG(st.st_mode)) return {};
+  if (auto m = maps.find(key); m && (*m)->matches(st)) return *m;
+
+  // Map outside the lock; two threads missing at once just both map it.
+  int fd = open(key.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return {};
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return {};
+  }
+  void* data{};
+  if (st.st_size > 0) {
+    data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      return {};
+    }
+    // Clients read from the front to the back, and the first one shouldn't
+    // wait on page faults one at a time.
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    madvise(data, st.st_size, MADV_WILLNEED);
+  }
+  close(fd);
+  auto mapping = std::make_shared<const Mapping>(data, st);
+  maps.insert(std::move(key), mapping);
+  return mapping;
+}
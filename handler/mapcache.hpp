@@ -0,0 +1,53 @@
+#pragma once
+
+#include <sys/stat.h>
+
+#include <boost/core/noncopyable.hpp>
+#include <filesystem>
+
+#include "../lru.hpp"
+#include "../types.hpp"
+
+/**
+ * MapCache maps files into memory once and shares the mapping between every
+ * connection that sends them. Entries are keyed by path and checked against
+ * the file's device, inode, size and mtime on each lookup, so a replaced file
+ * gets a fresh mapping while connections still sending the old one keep it
+ * alive until they're done.
+ *
+ * @par
+ * At most max_maps files stay mapped; the least recently used are unmapped
+ * once nobody holds them. Files must be replaced (e.g. renamed over), not
+ * truncated in place: touching a mapped page past the new end of a file is a
+ * SIGBUS. It's safe to use from any thread.
+ */
+class MapCache : boost::noncopyable {
+ public:
+  struct Mapping : boost::noncopyable {
+    Mapping(void* data, const struct stat& st);
+    ~Mapping();
+
+    span<const char> bytes() const noexcept { return {data, size}; }
+
+    const char* const data;
+    const size_t size;
+    const dev_t dev;
+    const ino_t ino;
+    const timespec mtime;
+
+    /// Whether st describes the same version of the same file.
+    bool matches(const struct stat& st) const noexcept;
+  };
+  using mapping_ptr = std::shared_ptr<const Mapping>;
+
+  explicit MapCache(size_t max_maps = 1024) : maps{max_maps} {}
+
+  /// The mapping of the regular file at p, or nullptr if there isn't one.
+  mapping_ptr map(const std::filesystem::path& p);
+
+  size_t size() const { return maps.size(); }
+
+ private:
+  // One shard, so max_maps is exact: each lookup costs a stat(2) anyway.
+  ShardedLru<mapping_ptr, 1> maps;
+};
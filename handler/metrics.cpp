@@ -0,0 +1,23 @@
+#include "metrics.hpp"
+
+namespace {
+
+bool is_loopback(const asio::ip::address& a) {
+  if (a.is_v6() && a.to_v6().is_v4_mapped())
+    return asio::ip::make_address_v4(asio::ip::v4_mapped, a.to_v6())
+        .is_loopback();
+  return a.is_loopback();
+}
+
+}  // namespace
+
+awaitable<body_ptr> MetricsHandler::operator()(const Request&, Response& res) {
+  err ec;
+  auto peer = res.socket.lowest_layer().remote_endpoint(ec);
+  if (ec || !is_loopback(peer.address())) {
+    res.header(Response::code_t::not_found, "Not found.");
+    co_return nullptr;
+  }
+  res.header(Response::code_t::success, "text/plain; version=0.0.4");
+  co_return make_body<StringBody>(res, metrics->prometheus());
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "../handler.hpp"
+#include "../metrics.hpp"
+
+/**
+ * MetricsHandler serves Metrics::prometheus() as text/plain, to clients on
+ * the loopback interface only; anyone else gets "51 Not found.", as if
+ * there were nothing there.
+ */
+class MetricsHandler {
+ public:
+  explicit MetricsHandler(const Metrics& _metrics) : metrics{&_metrics} {}
+
+  awaitable<body_ptr> operator()(const Request&, Response&);
+
+ private:
+  const Metrics* metrics;
+};
@@ -0,0 +1,90 @@
+#include "handoff.hpp"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstring>
+
+namespace {
+
+// A single message can carry this many; far more than anyone has workers.
+constexpr size_t max_fds{253};
+
+[[noreturn]] void fail(const char* what) {
+  throw std::system_error{errno, std::system_category(), what};
+}
+
+}  // namespace
+
+int handoff::connect(const std::filesystem::path& path) {
+  sockaddr_un addr{.sun_family = AF_UNIX};
+  if (path.native().size() >= sizeof addr.sun_path) {
+    errno = ENAMETOOLONG;
+    fail("handoff socket");
+  }
+  std::strcpy(addr.sun_path, path.c_str());
+
+  int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) fail("socket");
+  if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) < 0) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+void handoff::send_fds(int conn, std::span<const int> fds) {
+  if (fds.size() > max_fds) {
+    errno = EINVAL;
+    fail("send_fds");
+  }
+  // The count goes along too, so the receiver knows if any got lost.
+  auto count{static_cast<uint8_t>(fds.size())};
+  iovec iov{&count, 1};
+  array<char, CMSG_SPACE(max_fds * sizeof(int))> control{};
+  msghdr msg{.msg_iov = &iov, .msg_iovlen = 1};
+  if (!fds.empty()) {
+    msg.msg_control = control.data();
+    msg.msg_controllen = CMSG_SPACE(fds.size_bytes());
+    auto cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(fds.size_bytes());
+    std::memcpy(CMSG_DATA(cmsg), fds.data(), fds.size_bytes());
+  }
+  ssize_t n;
+  do n = ::sendmsg(conn, &msg, MSG_NOSIGNAL);
+  while (n < 0 && errno == EINTR);
+  if (n != 1) fail("sendmsg");
+}
+
+vector<int> handoff::receive_fds(int conn) {
+  uint8_t count{};
+  iovec iov{&count, 1};
+  array<char, CMSG_SPACE(max_fds * sizeof(int))> control{};
+  msghdr msg{.msg_iov = &iov,
+             .msg_iovlen = 1,
+             .msg_control = control.data(),
+             .msg_controllen = control.size()};
+  ssize_t n;
+  do n = ::recvmsg(conn, &msg, MSG_CMSG_CLOEXEC);
+  while (n < 0 && errno == EINTR);
+  if (n < 0) fail("recvmsg");
+
+  vector<int> fds;
+  for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+      continue;
+    auto k = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    auto first = fds.size();
+    fds.resize(first + k);
+    std::memcpy(fds.data() + first, CMSG_DATA(cmsg), k * sizeof(int));
+  }
+  if (n != 1 || fds.size() != count || (msg.msg_flags & MSG_CTRUNC)) {
+    for (auto fd : fds) ::close(fd);
+    errno = EPROTO;
+    fail("receive_fds");
+  }
+  return fds;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <filesystem>
+#include <span>
+
+#include "types.hpp"
+
+/**
+ * Handing listening sockets from a running server to the one replacing it,
+ * so a restart never has a moment with nothing listening. The old server
+ * listens on a Unix socket; the new one connects to it, and gets the
+ * listening sockets themselves as SCM_RIGHTS, before it binds anything.
+ * Once it's accepting on them it sends one byte back, and only then does
+ * the old one stop accepting and drain. If the new one dies first, the old
+ * one carries on as if nothing happened.
+ *
+ * These are plain blocking calls; everything they talk to is local.
+ */
+namespace handoff {
+
+/// Connect to the Unix socket at path; -1 if nothing's listening there.
+int connect(const std::filesystem::path& path);
+
+/// Send fds over the Unix socket conn, in one message. Throws system_error.
+void send_fds(int conn, std::span<const int> fds);
+
+/// Receive what send_fds sent; the fds are the caller's to close. Throws
+/// system_error.
+vector<int> receive_fds(int conn);
+
+}  // namespace handoff
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+#include "types.hpp"
+
+/**
+ * Histogram counts values in log-linear buckets, like HdrHistogram: every
+ * power of two is split into 2^SubBits equal buckets, so each recorded value
+ * is known to within 1/2^SubBits of itself, anywhere from 0 to 2^64, with a
+ * fixed number of buckets and no allocation.
+ *
+ * @par
+ * It expects one writer and any number of readers. The writer updates with
+ * relaxed atomic loads and stores, which cost the same as plain ones;
+ * readers may see a slightly stale picture.
+ */
+template <unsigned SubBits = 5>
+class Histogram {
+ public:
+  static constexpr size_t sub_buckets{size_t{1} << SubBits};
+  static constexpr size_t bucket_count{(64 - SubBits + 1) * sub_buckets};
+
+  /// The bucket v lands in.
+  static constexpr size_t index(uint64_t v) noexcept {
+    if (v < sub_buckets) return v;
+    unsigned shift = std::bit_width(v) - 1 - SubBits;
+    return ((shift + 1) << SubBits) + ((v >> shift) - sub_buckets);
+  }
+
+  /// The smallest value that lands in bucket i.
+  static constexpr uint64_t lower_bound(size_t i) noexcept {
+    if (i < sub_buckets) return i;
+    unsigned shift = (i >> SubBits) - 1;
+    return (sub_buckets + (i & (sub_buckets - 1))) << shift;
+  }
+
+  /// The largest value that lands in bucket i.
+  static constexpr uint64_t upper_bound(size_t i) noexcept {
+    return i + 1 < bucket_count ? lower_bound(i + 1) - 1 : ~uint64_t{};
+  }
+
+  void record(uint64_t v, uint64_t n = 1) noexcept {
+    bump(buckets[index(v)], n);
+    bump(_count, n);
+    bump(_sum, v * n);
+    if (v > _max.load(std::memory_order_relaxed))
+      _max.store(v, std::memory_order_relaxed);
+  }
+
+  uint64_t count() const noexcept {
+    return _count.load(std::memory_order_relaxed);
+  }
+  uint64_t sum() const noexcept { return _sum.load(std::memory_order_relaxed); }
+  uint64_t max() const noexcept { return _max.load(std::memory_order_relaxed); }
+
+  /**
+   * quantile(q) returns the value that a fraction q (from 0 to 1) of the
+   * recorded values are at or below, rounded up to the top of its bucket.
+   */
+  uint64_t quantile(double q) const noexcept {
+    auto n{count()};
+    if (n == 0) return 0;
+    auto rank{std::max<uint64_t>(1, std::ceil(q * n))};
+    uint64_t seen{};
+    for (size_t i{}; i < bucket_count; ++i) {
+      seen += buckets[i].load(std::memory_order_relaxed);
+      if (seen >= rank) return std::min(upper_bound(i), max());
+    }
+    return max();
+  }
+
+  /// Calls f(lower, upper, count) for each non-empty bucket, in order.
+  template <typename F>
+  void for_each_bucket(F&& f) const {
+    for (size_t i{}; i < bucket_count; ++i) {
+      if (auto n{buckets[i].load(std::memory_order_relaxed)}; n)
+        f(lower_bound(i), upper_bound(i), n);
+    }
+  }
+
+  /// Add in everything o recorded. Only the writer may do this.
+  Histogram& operator+=(const Histogram& o) noexcept {
+    for (size_t i{}; i < bucket_count; ++i)
+      bump(buckets[i], o.buckets[i].load(std::memory_order_relaxed));
+    bump(_count, o.count());
+    bump(_sum, o.sum());
+    if (o.max() > max()) _max.store(o.max(), std::memory_order_relaxed);
+    return *this;
+  }
+
+ private:
+  array<std::atomic<uint64_t>, bucket_count> buckets{};
+  std::atomic<uint64_t> _count{}, _sum{}, _max{};
+
+  static void bump(std::atomic<uint64_t>& a, uint64_t n) noexcept {
+    a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+};
@@ -0,0 +1,303 @@
+/*
+ * loadgen drives a running castor over real TLS connections and reports
+ * throughput and handshake/TTFB latency percentiles. Each request gets a
+ * connection of its own, as Gemini requires, so handshakes dominate unless
+ * session resumption (-r) is on.
+ */
+
+#include <unistd.h>
+
+#include <chrono>
+#include <iomanip>
+#include <map>
+#include <random>
+#include <thread>
+
+#include <boost/core/noncopyable.hpp>
+
+#include "histogram.hpp"
+#include "net-types.hpp"
+#include "openssl.hpp"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+/// Kinds of request, so a mix can stress different server paths.
+enum class kind { static_file, missing, redirect };
+
+/// Paths for each kind, against the handlers main.cpp sets up.
+const std::map<kind, vector<string>> default_paths{
+    {kind::static_file, {"/asdf/", "/asdf/index.gmi"}},
+    {kind::missing, {"/asdf/missing.gmi", "/nowhere"}},
+    {kind::redirect, {"/asdf"}},
+};
+
+const std::map<string_view, kind> kind_names{
+    {"static", kind::static_file},
+    {"missing", kind::missing},
+    {"redirect", kind::redirect},
+};
+
+struct Options {
+  string host{"localhost"};
+  string port{"1965"};
+  unsigned connections{64};
+  unsigned threads{1};
+  size_t requests{10000};
+  std::chrono::seconds duration{};
+  bool resume{};
+  std::map<kind, unsigned> mix{{kind::static_file, 1}};
+};
+
+/// Parses a mix like "static=8,missing=1,redirect=1".
+std::map<kind, unsigned> parse_mix(string_view s) {
+  std::map<kind, unsigned> mix;
+  while (!s.empty()) {
+    auto item{s.substr(0, s.find(','))};
+    s.remove_prefix(std::min(s.length(), item.length() + 1));
+    auto eq{item.find('=')};
+    auto it{kind_names.find(item.substr(0, eq))};
+    if (it == kind_names.end())
+      throw std::invalid_argument{"unknown request kind: " + string{item}};
+    mix[it->second] =
+        eq == string_view::npos ? 1 : std::stoul(string{item.substr(eq + 1)});
+  }
+  return mix;
+}
+
+/// Everything measured, per thread and then in total. Latencies are in ns.
+struct Stats {
+  Histogram<> connect, handshake, ttfb, total;
+  uint64_t requests{}, errors{}, resumed{}, bytes{};
+  std::map<int, uint64_t> status;
+
+  Stats& operator+=(const Stats& o) {
+    connect += o.connect;
+    handshake += o.handshake;
+    ttfb += o.ttfb;
+    total += o.total;
+    requests += o.requests;
+    errors += o.errors;
+    resumed += o.resumed;
+    bytes += o.bytes;
+    for (auto [code, n] : o.status) status[code] += n;
+    return *this;
+  }
+};
+
+uint64_t since(clock_type::time_point t) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             clock_type::now() - t)
+      .count();
+}
+
+/// Hands out requests until the count or the time runs out.
+class Budget {
+ public:
+  Budget(const Options& options)
+      : remaining{options.duration.count() ? ~size_t{} >> 1
+                                           : options.requests},
+        deadline{options.duration.count()
+                     ? clock_type::now() + options.duration
+                     : clock_type::time_point::max()} {}
+
+  bool take() {
+    return clock_type::now() < deadline &&
+           remaining.fetch_sub(1, std::memory_order_relaxed) > 0;
+  }
+
+ private:
+  std::atomic<std::make_signed_t<size_t>> remaining;
+  const clock_type::time_point deadline;
+};
+
+class Worker : boost::noncopyable {
+ public:
+  Worker(const Options& options, tcp::endpoint endpoint, Budget& budget,
+         unsigned seed)
+      : options{options}, endpoint{endpoint}, budget{budget}, rng{seed} {
+    for (auto [k, weight] : options.mix) {
+      for (auto& p : default_paths.at(k)) {
+        paths.push_back("gemini://" + options.host + ':' + options.port + p +
+                        "\r\n");
+        weights.push_back(weight);
+      }
+    }
+    pick = {weights.begin(), weights.end()};
+  }
+
+  void run() {
+    for (unsigned i{}; i < options.connections; ++i)
+      co_spawn(io, loop(), detached);
+    io.run();
+  }
+
+  Stats stats;
+
+ private:
+  const Options& options;
+  const tcp::endpoint endpoint;
+  Budget& budget;
+  io_context io{1};
+  ssl::context ctx{ssl::context::tlsv13_client};
+  std::mt19937 rng;
+  vector<string> paths;
+  vector<unsigned> weights;
+  std::discrete_distribution<size_t> pick;
+  /// The last session handed out by the server, for resumption.
+  std::optional<openssl::Session> session;
+
+  awaitable<void> loop() {
+    while (budget.take()) {
+      try {
+        co_await request(paths[pick(rng)]);
+      } catch (system_error&) {
+        ++stats.errors;
+      }
+    }
+  }
+
+  awaitable<void> request(string_view line) {
+    ssl_socket s{io, ctx};
+    SSL_set_tlsext_host_name(s.native_handle(), options.host.c_str());
+    if (options.resume && session)
+      SSL_set_session(s.native_handle(), session->native_handle());
+
+    auto start{clock_type::now()};
+    co_await s.next_layer().async_connect(endpoint);
+    stats.connect.record(since(start));
+
+    auto connected{clock_type::now()};
+    co_await s.async_handshake(ssl::stream_base::client);
+    stats.handshake.record(since(connected));
+    if (SSL_session_reused(s.native_handle())) ++stats.resumed;
+
+    auto sent{clock_type::now()};
+    co_await asio::async_write(s, asio::buffer(line.data(), line.size()));
+
+    array<char, 16384> buf;
+    auto n{co_await s.async_read_some(asio::buffer(buf))};
+    stats.ttfb.record(since(sent));
+    int code{n >= 2 ? (buf[0] - '0') * 10 + (buf[1] - '0') : -1};
+
+    size_t bytes{n};
+    for (err e;;) {
+      bytes += co_await s.async_read_some(
+          asio::buffer(buf), asio::redirect_error(asio::use_awaitable, e));
+      if (e == asio::error::eof || e == ssl::error::stream_truncated) break;
+      if (e) throw system_error{e};
+    }
+    stats.total.record(since(start));
+    ++stats.requests;
+    ++stats.status[code];
+    stats.bytes += bytes;
+
+    // TLS 1.3 tickets arrive after the handshake, so only now is there a
+    // session worth resuming. The server already closed, so don't send a
+    // close_notify, but mark the connection as shut down cleanly; otherwise
+    // OpenSSL marks the session unresumable when s is freed.
+    if (options.resume) {
+      SSL_set_shutdown(s.native_handle(),
+                       SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+      session.emplace(SSL_get_session(s.native_handle()));
+    }
+  }
+};
+
+void report(const Stats& s, double seconds) {
+  cout << std::fixed << std::setprecision(1) << s.requests << " requests in "
+       << seconds << " s: " << s.requests / seconds << " req/s, "
+       << s.bytes / seconds / 1e6 << " MB/s, " << s.errors << " errors, "
+       << s.resumed << " resumed\n";
+  for (auto [code, n] : s.status) cout << "  status " << code << ": " << n << '\n';
+
+  cout << std::setw(12) << "latency µs" << std::setw(10) << "p50"
+       << std::setw(10) << "p99" << std::setw(10) << "p99.9" << std::setw(10)
+       << "max" << '\n';
+  auto row = [](const char* name, const Histogram<>& h) {
+    cout << std::setw(11) << name;
+    for (auto q : {0.5, 0.99, 0.999})
+      cout << std::setw(10) << h.quantile(q) / 1e3;
+    cout << std::setw(10) << h.max() / 1e3 << '\n';
+  };
+  row("connect", s.connect);
+  row("handshake", s.handshake);
+  row("ttfb", s.ttfb);
+  row("total", s.total);
+}
+
+void usage(const char* argv0) {
+  cerr << "Usage: " << argv0
+       << " [-c connections] [-t threads] [-n requests | -d seconds] [-r]\n"
+       << "       [-m mix] [host [port]]\n"
+       << "  -c connections  connections in flight per thread (default: 64)\n"
+       << "  -t threads      client threads (default: 1)\n"
+       << "  -n requests     stop after this many requests (default: 10000)\n"
+       << "  -d seconds      run for this long instead\n"
+       << "  -r              resume TLS sessions\n"
+       << "  -m mix          weights per kind of request, e.g.\n"
+       << "                  static=8,missing=1,redirect=1 (default: static)\n";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Options options;
+
+  try {
+    for (int opt; (opt = getopt(argc, argv, "c:t:n:d:rm:h")) != -1;) {
+      switch (opt) {
+        case 'c':
+          options.connections = std::stoul(optarg);
+          break;
+        case 't':
+          options.threads = std::max(1ul, std::stoul(optarg));
+          break;
+        case 'n':
+          options.requests = std::stoull(optarg);
+          break;
+        case 'd':
+          options.duration = std::chrono::seconds{std::stoul(optarg)};
+          break;
+        case 'r':
+          options.resume = true;
+          break;
+        case 'm':
+          options.mix = parse_mix(optarg);
+          break;
+        default:
+          usage(argv[0]);
+          return opt == 'h' ? 0 : 2;
+      }
+    }
+    if (optind < argc) options.host = argv[optind++];
+    if (optind < argc) options.port = argv[optind++];
+
+    io_context io;
+    // Resolve once up front, so lookups aren't part of what's measured.
+    tcp::endpoint endpoint{
+        *tcp::resolver{io}.resolve(options.host, options.port).begin()};
+
+    Budget budget{options};
+    vector<std::unique_ptr<Worker>> workers;
+    for (unsigned i{}; i < options.threads; ++i)
+      workers.push_back(
+          std::make_unique<Worker>(options, endpoint, budget, i + 1));
+
+    auto start{clock_type::now()};
+    {
+      vector<std::jthread> threads;
+      for (auto& w : workers) threads.emplace_back([&w = *w] { w.run(); });
+    }
+    auto seconds{since(start) / 1e9};
+
+    Stats total;
+    for (auto& w : workers) total += w->stats;
+    report(total, seconds);
+  } catch (std::exception& e) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,205 @@
+#include "log.hpp"
+
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <condition_variable>
+#include <ctime>
+
+namespace logging {
+
+namespace {
+
+/**
+ * Ring is one thread's queue of records. Its thread is the only producer and
+ * the Writer is the only consumer, so head and tail are all it takes.
+ */
+struct Ring {
+  static constexpr size_t capacity{1024};
+
+  array<Record, capacity> records;
+  alignas(64) std::atomic<size_t> head{};  // Next to fill; producer's
+  alignas(64) std::atomic<size_t> tail{};  // Next to drain; Writer's
+  std::atomic<uint64_t> dropped{};
+};
+
+std::mutex rings_mutex;
+// Rings outlive their threads, so the Writer can finish draining them.
+vector<shared_ptr<Ring>> rings;
+
+Ring& local_ring() {
+  thread_local shared_ptr<Ring> ring = [] {
+    auto r{std::make_shared<Ring>()};
+    std::scoped_lock lock{rings_mutex};
+    rings.push_back(r);
+    return r;
+  }();
+  return *ring;
+}
+
+constexpr string_view level_names[]{"DEBUG", "INFO", "WARNING", "ERROR"};
+
+// Longest line format() writes.
+constexpr size_t max_line{64 + INET6_ADDRSTRLEN + sizeof Record::text};
+
+char* put_time(char* p, std::chrono::system_clock::time_point t) {
+  using namespace std::chrono;
+  auto secs{system_clock::to_time_t(t)};
+  std::tm tm;
+  gmtime_r(&secs, &tm);
+  p += std::strftime(p, 32, "%FT%T", &tm);
+  auto ms{duration_cast<milliseconds>(t.time_since_epoch()).count() % 1000};
+  *p++ = '.';
+  *p++ = '0' + ms / 100;
+  *p++ = '0' + ms / 10 % 10;
+  *p++ = '0' + ms % 10;
+  *p++ = 'Z';
+  return p;
+}
+
+char* put_peer(char* p, const endpoint& ep) {
+  auto sa{ep.data()};
+  if (sa->sa_family == AF_INET6) {
+    *p++ = '[';
+    inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6*>(sa)->sin6_addr,
+              p, INET6_ADDRSTRLEN);
+    p += std::strlen(p);
+    *p++ = ']';
+  } else {
+    inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in*>(sa)->sin_addr, p,
+              INET_ADDRSTRLEN);
+    p += std::strlen(p);
+  }
+  *p++ = ':';
+  return std::to_chars(p, p + 5, ep.port()).ptr;
+}
+
+/**
+ * One line per record:
+ *   2022-07-04T12:00:00.000Z 127.0.0.1:41234 20 1234us /path text/gemini
+ *   2022-07-04T12:00:00.000Z DEBUG 127.0.0.1:41234 Connected
+ */
+char* format(char* p, const Record& r) {
+  p = put_time(p, r.time);
+  *p++ = ' ';
+  if (r.status == 0) {
+    auto name{level_names[static_cast<size_t>(r.lvl)]};
+    p = std::copy(name.begin(), name.end(), p);
+    *p++ = ' ';
+  }
+  if (r.has_peer) {
+    p = put_peer(p, r.peer);
+    *p++ = ' ';
+  }
+  if (r.status != 0) {
+    p = std::to_chars(p, p + 3, r.status).ptr;
+    *p++ = ' ';
+    p = std::to_chars(p, p + 20, r.elapsed.count()).ptr;
+    p = std::copy_n("us ", 3, p);
+  }
+  p = std::copy_n(r.text.data(), r.length, p);
+  *p++ = '\n';
+  return p;
+}
+
+void write_all(int fd, const char* p, size_t n) {
+  while (n > 0) {
+    auto w{::write(fd, p, n)};
+    if (w < 0) {
+      if (errno == EINTR) continue;
+      // Nowhere left to complain to.
+      return;
+    }
+    p += w;
+    n -= w;
+  }
+}
+
+/// Format everything waiting in every ring into one buffer, then write it.
+void drain(int fd, vector<char>& buf) {
+  char* p{buf.data()};
+  auto flush = [&] {
+    write_all(fd, buf.data(), p - buf.data());
+    p = buf.data();
+  };
+  auto room = [&](size_t n) {
+    if (static_cast<size_t>(buf.data() + buf.size() - p) < n) flush();
+  };
+
+  vector<shared_ptr<Ring>> snapshot;
+  {
+    std::scoped_lock lock{rings_mutex};
+    snapshot = rings;
+  }
+  for (auto& ring : snapshot) {
+    auto t{ring->tail.load(std::memory_order_relaxed)};
+    auto h{ring->head.load(std::memory_order_acquire)};
+    for (; t != h; ++t) {
+      room(max_line);
+      p = format(p, ring->records[t % Ring::capacity]);
+    }
+    ring->tail.store(t, std::memory_order_release);
+
+    if (auto n{ring->dropped.exchange(0, std::memory_order_relaxed)}; n) {
+      room(64);
+      p = std::copy_n("Dropped ", 8, p);
+      p = std::to_chars(p, p + 20, n).ptr;
+      p = std::copy_n(" log records\n", 13, p);
+    }
+  }
+  flush();
+}
+
+}  // namespace
+
+namespace detail {
+
+std::atomic<level> threshold{level::off};
+
+Record* acquire() noexcept {
+  auto& ring{local_ring()};
+  auto h{ring.head.load(std::memory_order_relaxed)};
+  if (h - ring.tail.load(std::memory_order_acquire) == Ring::capacity) {
+    ring.dropped.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+  }
+  auto& r{ring.records[h % Ring::capacity]};
+  r.time = std::chrono::system_clock::now();
+  return &r;
+}
+
+void commit() noexcept {
+  auto& ring{local_ring()};
+  ring.head.store(ring.head.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_release);
+}
+
+}  // namespace detail
+
+Writer::Writer(int _fd, level threshold) : fd{_fd} {
+  detail::threshold.store(threshold);
+  thread = std::jthread{[this](std::stop_token st) { run(st); }};
+}
+
+Writer::~Writer() {
+  thread.request_stop();
+  thread.join();
+  detail::threshold.store(level::off);
+}
+
+void Writer::run(std::stop_token st) {
+  vector<char> buf(1 << 16);
+  std::mutex m;
+  std::condition_variable_any cv;
+  // Draining every few milliseconds batches records up without holding any
+  // for long enough to notice.
+  while (!st.stop_requested()) {
+    drain(fd, buf);
+    std::unique_lock lock{m};
+    cv.wait_for(lock, st, 10ms, [] { return false; });
+  }
+  drain(fd, buf);
+}
+
+}  // namespace logging
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/core/noncopyable.hpp>
+#include <charconv>
+#include <chrono>
+#include <concepts>
+#include <cstring>
+#include <mutex>
+
+#include "types.hpp"
+
+/**
+ * Logging that stays off the connection path. log() and access() copy a
+ * fixed-size Record into a ring that belongs to the calling thread, with no
+ * locks, no allocation and no I/O; a Writer thread formats whatever has
+ * piled up in all the rings and writes it out in large batches.
+ *
+ * @par
+ * Anything below the Writer's level costs one relaxed load. If a ring fills
+ * up faster than the Writer drains it, records are dropped and counted
+ * rather than making a connection wait. Nothing is logged until a Writer
+ * exists.
+ */
+namespace logging {
+
+enum class level : uint8_t { debug, info, warning, error, off };
+
+using endpoint = boost::asio::ip::tcp::endpoint;
+
+struct Record {
+  std::chrono::system_clock::time_point time;
+  endpoint peer;
+  /// For access records, how long the request took.
+  std::chrono::microseconds elapsed;
+  level lvl;
+  bool has_peer;
+  /// Access records have a status; other messages have 0.
+  uint8_t status;
+  uint16_t length;
+  array<char, 192> text;
+};
+
+/**
+ * Writer drains every thread's ring to fd until it's destroyed, then drains
+ * them one last time. Only one may exist at a time.
+ */
+class Writer : boost::noncopyable {
+ public:
+  Writer(int fd, level threshold);
+  ~Writer();
+
+ private:
+  const int fd;
+  std::jthread thread;
+
+  void run(std::stop_token);
+};
+
+namespace detail {
+
+extern std::atomic<level> threshold;
+
+/// The next free Record in this thread's ring, or nullptr if it's full.
+Record* acquire() noexcept;
+/// Hand the Record from acquire() over to the Writer.
+void commit() noexcept;
+
+struct Appender {
+  char *p, *const end;
+
+  void operator()(char c) {
+    if (p != end) *p++ = c;
+  }
+  void operator()(std::integral auto v) { p = std::to_chars(p, end, v).ptr; }
+  void operator()(string_view s) {
+    auto n{std::min<size_t>(s.length(), end - p)};
+    std::memcpy(p, s.data(), n);
+    p += n;
+  }
+};
+
+template <typename... Args>
+void put(Record& r, const Args&... args) {
+  Appender a{r.text.data(), r.text.data() + r.text.size()};
+  (a(args), ...);
+  r.length = a.p - r.text.data();
+}
+
+}  // namespace detail
+
+inline bool enabled(level lvl) noexcept {
+  return lvl >= detail::threshold.load(std::memory_order_relaxed);
+}
+
+/// Log the concatenation of args, which are strings, chars or integers.
+template <typename... Args>
+void log(level lvl, const Args&... args) {
+  if (!enabled(lvl)) return;
+  if (auto r{detail::acquire()}) {
+    r->lvl = lvl;
+    r->has_peer = false;
+    r->status = 0;
+    detail::put(*r, args...);
+    detail::commit();
+  }
+}
+
+/// Log the concatenation of args about a connection from peer.
+template <typename... Args>
+void log(level lvl, const endpoint& peer, const Args&... args) {
+  if (!enabled(lvl)) return;
+  if (auto r{detail::acquire()}) {
+    r->lvl = lvl;
+    r->peer = peer;
+    r->has_peer = true;
+    r->status = 0;
+    detail::put(*r, args...);
+    detail::commit();
+  }
+}
+
+/// Log a finished request: who, how it went, how long it took, and args.
+template <typename... Args>
+void access(const endpoint& peer, int status,
+            std::chrono::microseconds elapsed, const Args&... args) {
+  if (!enabled(level::info)) return;
+  if (auto r{detail::acquire()}) {
+    r->lvl = level::info;
+    r->peer = peer;
+    r->has_peer = true;
+    r->status = status;
+    r->elapsed = elapsed;
+    detail::put(*r, args...);
+    detail::commit();
+  }
+}
+
+}  // namespace logging
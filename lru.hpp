@@ -0,0 +1,139 @@
+#pragma once
+
+#include <boost/core/noncopyable.hpp>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+#include "types.hpp"
+
+/**
+ * Lru maps strings to values, and once the values' total cost passes
+ * capacity, evicts the least recently used. Each value costs 1 unless it's
+ * inserted with a cost of its own. It isn't locked; ShardedLru is.
+ */
+template <typename V>
+class Lru {
+ public:
+  explicit Lru(size_t _capacity = 0) : capacity{_capacity} {}
+
+  /// The value at key, now the most recently used; nullptr if none.
+  V* find(string_view key) noexcept {
+    auto it{index.find(key)};
+    if (it == index.end()) return nullptr;
+    lru.splice(lru.begin(), lru, it->second);
+    return &it->second->value;
+  }
+
+  /// Put value at key, in place of whatever was there, and evict to make
+  /// room. Something costing more than capacity evicts everything, itself
+  /// included.
+  void insert(string key, V value, size_t cost = 1) {
+    erase(key);
+    lru.push_front({std::move(key), std::move(value), cost});
+    index.emplace(lru.front().key, lru.begin());
+    total += cost;
+    while (total > capacity) erase(std::prev(lru.end()));
+  }
+
+  void erase(string_view key) noexcept {
+    if (auto it{index.find(key)}; it != index.end()) erase(it->second);
+  }
+
+  void clear() noexcept {
+    index.clear();
+    lru.clear();
+    total = 0;
+  }
+
+  size_t size() const noexcept { return lru.size(); }
+  size_t cost() const noexcept { return total; }
+
+ private:
+  struct Node {
+    string key;
+    V value;
+    size_t cost;
+  };
+  using list_t = std::list<Node>;
+
+  size_t capacity;
+  list_t lru;  // Most recently used first
+  // Keyed by views into the nodes' keys.
+  std::unordered_map<string_view, typename list_t::iterator> index;
+  size_t total{};
+
+  void erase(typename list_t::iterator it) noexcept {
+    total -= it->cost;
+    index.erase(it->key);
+    lru.erase(it);
+  }
+};
+
+/**
+ * ShardedLru is an Lru split by key into shards, each with its own lock and
+ * an even share of the capacity, so threads after different keys rarely
+ * wait on each other. Values come out by copy, so they should be cheap to
+ * copy, like a shared_ptr. It's safe to use from any thread.
+ */
+template <typename V, size_t Shards = 16>
+class ShardedLru : boost::noncopyable {
+ public:
+  explicit ShardedLru(size_t capacity) {
+    for (auto& s : shards) s.lru = Lru<V>{shard_capacity(capacity)};
+  }
+
+  /// What each shard holds, for a total of capacity; never 0.
+  static constexpr size_t shard_capacity(size_t capacity) noexcept {
+    return std::max<size_t>(1, capacity / Shards);
+  }
+
+  std::optional<V> find(string_view key) {
+    auto& s{shard_for(key)};
+    std::scoped_lock lock{s.mutex};
+    if (auto v{s.lru.find(key)}; v) return std::as_const(*v);
+    return {};
+  }
+
+  void insert(string key, V value, size_t cost = 1) {
+    auto& s{shard_for(key)};
+    std::scoped_lock lock{s.mutex};
+    s.lru.insert(std::move(key), std::move(value), cost);
+  }
+
+  void erase(string_view key) {
+    auto& s{shard_for(key)};
+    std::scoped_lock lock{s.mutex};
+    s.lru.erase(key);
+  }
+
+  void clear() {
+    for (auto& s : shards) {
+      std::scoped_lock lock{s.mutex};
+      s.lru.clear();
+    }
+  }
+
+  size_t size() const {
+    size_t n{};
+    for (auto& s : shards) {
+      std::scoped_lock lock{s.mutex};
+      n += s.lru.size();
+    }
+    return n;
+  }
+
+ private:
+  struct Shard {
+    mutable std::mutex mutex;
+    Lru<V> lru;
+  };
+  array<Shard, Shards> shards;
+
+  Shard& shard_for(string_view key) noexcept {
+    // The low bits pick the bucket inside the shard; use the high ones here.
+    return shards[(std::hash<string_view>{}(key) >> 32) % Shards];
+  }
+};
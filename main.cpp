@@ -1,21 +1,255 @@
+#include <unistd.h>
+
+#include <array>
+#include <charconv>
+#include <concepts>
+#include <cstdio>
 #include <filesystem>
+#include <limits>
+#include <stdexcept>
 
 #include "handler.hpp"
 #include "handler/dir.hpp"
+#include "log.hpp"
 #include "net-types.hpp"
 #include "request.hpp"
 #include "response.hpp"
 #include "server.hpp"
 
+void usage(const char *argv0) {
+  cerr << "Usage: " << argv0
+       << " [-t threads] [-p] [-c cache_bytes] [-m] [-s off|cache|tickets]"
+          " [-k seconds] [-b bytes] [-u]\n"
+          "       [-C conns] [-H handshakes] [-I conns] [-Z]"
+          " [-T h,r,f,w] [-M path] [-P file]\n"
+          "       [-X file] [-x every,keep] [-R path] [-D seconds]"
+          " [-V name=dir]... [-v]\n"
+       << "  -t threads  worker threads; 0 means one per CPU (default: 1)\n"
+       << "  -p          pin each worker thread to its own CPU\n"
+       << "  -c bytes    cache up to this many bytes of small files, across\n"
+       << "              every host\n"
+       << "  -m          keep files memory-mapped; replace files, don't\n"
+       << "              truncate them, while serving\n"
+       << "  -s mode     how to resume TLS sessions (default: tickets)\n"
+       << "  -k seconds  session lifetime and ticket key rotation period,\n"
+       << "              from 1 to 604800 (default: 3600)\n"
+       << "  -b bytes    most buffer memory for responses in flight; writers\n"
+       << "              wait past it (default: 64 MiB)\n"
+       << "  -u          read files through io_uring with registered buffers,\n"
+       << "              where built with liburing\n"
+       << "  -C conns    most connections served at once; more are told\n"
+       << "              to slow down (default: 10000; 0 for no limit)\n"
+       << "  -H count    most TLS handshakes at once; more are closed\n"
+       << "              (default: 256; 0 for no limit)\n"
+       << "  -I conns    most connections from one address (default: 32)\n"
+       << "  -Z          close connections over a limit instead of\n"
+       << "              replying 44\n"
+       << "  -T h,r,f,w  seconds allowed for the handshake, the request,\n"
+       << "              the first byte of the response and each write\n"
+       << "              after it, each up to 86400 (default: 5,5,10,10)\n"
+       << "  -M path     serve metrics at this path, to loopback clients\n"
+       << "  -P file     keep Prometheus metrics in this file, rewritten\n"
+       << "              every 15 seconds\n"
+       << "  -X file     every minute, write the slowest connections' phase\n"
+       << "              traces here as Chrome trace-event JSON\n"
+       << "  -x n,k      trace one connection in n, and keep the slowest k\n"
+       << "              (default: 100,10)\n"
+       << "  -R path     take the listening sockets over from the server on\n"
+       << "              this Unix socket, if any, and hand them on from it\n"
+       << "  -D seconds  on SIGTERM or handing off, how long connections\n"
+       << "              get to finish (default: 30)\n"
+       << "  -V name=dir serve dir to clients asking for name, which may be\n"
+       << "              *.domain, with the certificate in certs/name/\n"
+       << "  -v          log every connection, not just requests\n";
+}
+
+// Far more than any machine has CPUs; past it is a typo.
+constexpr unsigned max_threads{1024};
+// TLS 1.3 won't let a ticket live longer than a week (RFC 8446 4.6.1).
+constexpr unsigned max_lifetime{7 * 24 * 3600};
+
+/// s as a T from min to max. Anything else, a sign included, throws
+/// invalid_argument, which gets the usage.
+template <std::unsigned_integral T>
+T number(string_view s, T min = 0, T max = std::numeric_limits<T>::max()) {
+  T n{};
+  auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), n);
+  if (ec != std::errc{} || end != s.data() + s.size() || n < min || n > max)
+    throw std::invalid_argument{string{s}};
+  return n;
+}
+
+// A phase that takes longer than this is as good as hung.
+constexpr unsigned max_timeout{24 * 3600};
+
+/// s as N comma-separated timeouts in seconds, each up to max_timeout.
+template <size_t N>
+std::array<std::chrono::seconds, N> seconds_list(string_view s) {
+  std::array<std::chrono::seconds, N> list;
+  for (size_t i{}; i < N; ++i) {
+    auto comma{i + 1 < N ? s.find(',') : s.size()};
+    if (comma == string_view::npos) throw std::invalid_argument{string{s}};
+    list[i] =
+        std::chrono::seconds{number(s.substr(0, comma), 0u, max_timeout)};
+    s.remove_prefix(std::min(comma + 1, s.size()));
+  }
+  return list;
+}
+
+ssl::context make_ssl_context(const std::filesystem::path& dir = "certs") {
+  ssl::context ssl_context(ssl::context::tlsv13_server);
+  ssl_context.use_certificate_file(dir / "cert.pem", ssl::context::pem);
+  ssl_context.use_private_key_file(dir / "privkey.pem", ssl::context::pem);
+  return ssl_context;
+}
+
 int main(int argc, char *argv[]) {
+  Server::Options options;
+  size_t cache_bytes{};
+  bool map_files{};
+  auto log_level{logging::level::info};
+  // Each -V, as name and directory.
+  vector<pair<string, string>> vhosts;
+
+  constexpr auto optstring{"t:pc:ms:k:b:uC:H:I:ZT:M:P:X:x:R:D:V:vh"};
+  // Numbers that don't parse, or are out of range, get the usage too.
   try {
-    ssl::context ssl_context(ssl::context::tlsv13_server);
-    ssl_context.use_certificate_file("certs/cert.pem", ssl::context::pem);
-    ssl_context.use_private_key_file("certs/privkey.pem", ssl::context::pem);
+    for (int opt; (opt = getopt(argc, argv, optstring)) != -1;) {
+      switch (opt) {
+        case 't':
+          options.threads = number(optarg, 0u, max_threads);
+          break;
+        case 'p':
+          options.pin_threads = true;
+          break;
+        case 'c':
+          cache_bytes = number<size_t>(optarg);
+          break;
+        case 'm':
+          map_files = true;
+          break;
+        case 's':
+          if (string_view m{optarg}; m == "off")
+            options.resumption.mode = Resumption::mode_t::off;
+          else if (m == "cache")
+            options.resumption.mode = Resumption::mode_t::cache;
+          else if (m == "tickets")
+            options.resumption.mode = Resumption::mode_t::tickets;
+          else {
+            usage(argv[0]);
+            return 2;
+          }
+          break;
+        case 'k':
+          options.resumption.lifetime =
+              std::chrono::seconds{number(optarg, 1u, max_lifetime)};
+          break;
+        case 'b':
+          options.buffers.cap = number<size_t>(optarg);
+          break;
+        case 'u':
+          if (!FileRing::available) {
+            cerr << argv[0] << ": -u needs io_uring, and this build has no "
+                               "liburing\n";
+            return 2;
+          }
+          options.file_ring.enabled = true;
+          break;
+        case 'C':
+          options.admission.max_connections = number<unsigned>(optarg);
+          break;
+        case 'H':
+          options.admission.max_handshakes = number<unsigned>(optarg);
+          break;
+        case 'I':
+          options.admission.max_per_ip = number<unsigned>(optarg);
+          break;
+        case 'Z':
+          options.admission.reply_slow_down = false;
+          break;
+        case 'T': {
+          auto &t = options.timeouts;
+          auto s = seconds_list<4>(optarg);
+          t.handshake = s[0];
+          t.request = s[1];
+          t.first_byte = s[2];
+          t.idle_write = s[3];
+          break;
+        }
+        case 'M':
+          options.metrics_route = optarg;
+          break;
+        case 'P':
+          options.metrics_file = optarg;
+          break;
+        case 'X':
+          options.tracing.file = optarg;
+          break;
+        case 'x': {
+          auto &t = options.tracing;
+          if (std::sscanf(optarg, "%u,%zu", &t.every, &t.keep) != 2) {
+            usage(argv[0]);
+            return 2;
+          }
+          break;
+        }
+        case 'R':
+          options.handoff = optarg;
+          break;
+        case 'D':
+          options.drain = std::chrono::seconds{number<unsigned>(optarg)};
+          break;
+        case 'V': {
+          string_view v{optarg};
+          auto eq{v.find('=')};
+          if (eq == 0 || eq == string_view::npos || eq + 1 == v.size()) {
+            usage(argv[0]);
+            return 2;
+          }
+          vhosts.emplace_back(v.substr(0, eq), v.substr(eq + 1));
+          break;
+        }
+        case 'v':
+          log_level = logging::level::debug;
+          break;
+        default:
+          usage(argv[0]);
+          return opt == 'h' ? 0 : 2;
+      }
+    }
+  } catch (const std::logic_error &) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  logging::Writer log_writer{STDOUT_FILENO, log_level};
+
+  try {
+    // SIGHUP does this again, to pick up a renewed certificate.
+    options.reload_tls = [] { return make_ssl_context(); };
+
+    // One of each for every host, so -c is the whole budget and there's one
+    // inotify thread, however many hosts there are.
+    vector<std::filesystem::path> roots{
+        std::filesystem::absolute("geminiroot")};
+    for (auto& [name, dir] : vhosts)
+      roots.push_back(std::filesystem::absolute(dir));
+    auto cache{cache_bytes ? std::make_shared<FileCache>(roots, cache_bytes)
+                           : nullptr};
+    auto maps{map_files ? std::make_shared<MapCache>() : nullptr};
 
     std::map<std::filesystem::path, Handler> handlers{
-        {"/asdf", DirHandler{"geminiroot"}}};
-    Server server{std::move(ssl_context), handlers};
+        {"/asdf", DirHandler{roots[0], cache, maps}}};
+    vector<Server::VirtualHost> hosts;
+    for (size_t i{}; i < vhosts.size(); ++i) {
+      hosts.push_back(
+          {vhosts[i].first,
+           [certs = std::filesystem::path{"certs"} / vhosts[i].first] {
+             return make_ssl_context(certs);
+           },
+           {{"/", DirHandler{roots[i + 1], cache, maps}}}});
+    }
+    Server server{make_ssl_context(), handlers, options, hosts};
     server.run();
   } catch (std::exception &e) {
     std::cerr << e.what() << endl;
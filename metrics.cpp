@@ -0,0 +1,148 @@
+#include "metrics.hpp"
+
+#include <bit>
+#include <sstream>
+
+namespace {
+
+thread_local Metrics::Shard* current{};
+
+// Prometheus wants label values quoted, with \, " and newlines escaped.
+string quoted(string_view s) {
+  string q{'"'};
+  for (auto c : s) {
+    if (c == '\\' || c == '"') q += '\\';
+    if (c == '\n') {
+      q += "\\n";
+      continue;
+    }
+    q += c;
+  }
+  q += '"';
+  return q;
+}
+
+// Prometheus buckets are cumulative and need the same bounds every time, so
+// fold the log-linear buckets into one per power of two of microseconds;
+// those edges are always on bucket edges.
+void seconds_histogram(std::ostream& out, string_view name, string_view label,
+                       const Metrics::Latency& h) {
+  constexpr unsigned top{26};  // About a minute.
+  array<uint64_t, top + 1> counts{};
+  uint64_t over{};
+  h.for_each_bucket([&](uint64_t, uint64_t upper, uint64_t n) {
+    if (auto b = std::bit_width(upper); b <= top)
+      counts[b] += n;
+    else
+      over += n;
+  });
+  uint64_t seen{};
+  for (unsigned b{}; b <= top; ++b) {
+    seen += counts[b];
+    // Bucket b holds values below 2^b microseconds.
+    out << name << "_bucket{" << label << ",le=\""
+        << static_cast<double>(uint64_t{1} << b) / 1e6 << "\"} " << seen
+        << '\n';
+  }
+  out << name << "_bucket{" << label << ",le=\"+Inf\"} " << seen + over << '\n'
+      << name << "_sum{" << label << "} " << static_cast<double>(h.sum()) / 1e6
+      << '\n'
+      << name << "_count{" << label << "} " << h.count() << '\n';
+}
+
+}  // namespace
+
+void Metrics::Shard::record(const Trace& t) noexcept {
+  for (size_t p{}; p < phase_count; ++p) {
+    if (!t.ran(static_cast<phase_t>(p))) break;
+    phase_latency[p].record(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            t.duration(static_cast<phase_t>(p)))
+            .count());
+  }
+}
+
+Metrics::Metrics(vector<string> _mounts) : mounts{std::move(_mounts)} {}
+
+Metrics::Shard& Metrics::add_shard() {
+  return shards.emplace_back(shards.size(), mounts.size());
+}
+
+void Metrics::add_counter(string name, string help,
+                          std::function<uint64_t()> read) {
+  readings.push_back({std::move(name), std::move(help), false,
+                      std::move(read)});
+}
+
+void Metrics::add_gauge(string name, string help,
+                        std::function<uint64_t()> read) {
+  readings.push_back({std::move(name), std::move(help), true, std::move(read)});
+}
+
+void Metrics::bind(Shard& s) noexcept { current = &s; }
+
+Metrics::Shard* Metrics::local() noexcept { return current; }
+
+string Metrics::prometheus() const {
+  auto sum = [&](auto member) {
+    uint64_t n{};
+    for (auto& s : shards) n += (s.*member).value();
+    return n;
+  };
+
+  std::ostringstream out;
+  auto counter = [&](string_view name, string_view help, uint64_t n) {
+    out << "# HELP " << name << ' ' << help << '\n'
+        << "# TYPE " << name << " counter\n"
+        << name << ' ' << n << '\n';
+  };
+
+  auto accepted{sum(&Shard::accepted)}, closed{sum(&Shard::closed)};
+  counter("castor_connections_accepted_total", "Connections accepted.",
+          accepted);
+  out << "# HELP castor_connections_active Connections open now.\n"
+         "# TYPE castor_connections_active gauge\n"
+         "castor_connections_active "
+      // Shards are read one after the other, so this can be briefly off.
+      << (accepted > closed ? accepted - closed : 0) << '\n';
+  counter("castor_handshake_failures_total", "TLS handshakes that failed.",
+          sum(&Shard::handshake_failures));
+  counter("castor_bytes_sent_total", "Response bytes sent, headers included.",
+          sum(&Shard::bytes_sent));
+
+  for (auto& r : readings) {
+    out << "# HELP " << r.name << ' ' << r.help << '\n'
+        << "# TYPE " << r.name << (r.gauge ? " gauge\n" : " counter\n")
+        << r.name << ' ' << r.read() << '\n';
+  }
+
+  out << "# HELP castor_responses_total Responses sent, by status.\n"
+         "# TYPE castor_responses_total counter\n";
+  for (size_t code{}; code < std::tuple_size_v<decltype(Shard::responses)>;
+       ++code) {
+    uint64_t n{};
+    for (auto& s : shards) n += s.responses[code].value();
+    if (n)
+      out << "castor_responses_total{code=\"" << code << "\"} " << n << '\n';
+  }
+
+  out << "# HELP castor_handler_seconds Time from calling a handler to the "
+         "end of its response, by mount.\n"
+         "# TYPE castor_handler_seconds histogram\n";
+  for (size_t m{}; m < mounts.size(); ++m) {
+    Latency h;
+    for (auto& s : shards) h += s.handler_latency[m];
+    seconds_histogram(out, "castor_handler_seconds",
+                      "mount=" + quoted(mounts[m]), h);
+  }
+
+  out << "# HELP castor_phase_seconds Time connections spend in each phase.\n"
+         "# TYPE castor_phase_seconds histogram\n";
+  for (size_t p{}; p < phase_count; ++p) {
+    Latency h;
+    for (auto& s : shards) h += s.phase_latency[p];
+    seconds_histogram(out, "castor_phase_seconds",
+                      "phase=" + quoted(phase_names[p]), h);
+  }
+  return out.str();
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <boost/core/noncopyable.hpp>
+#include <deque>
+#include <functional>
+#include <memory>
+
+#include "histogram.hpp"
+#include "trace.hpp"
+#include "types.hpp"
+
+/**
+ * Metrics counts what every worker does, in a Shard per worker: each one
+ * starts on its own cache line and only its worker writes to it, so
+ * counting is a plain load and store with nobody to contend with. Reading
+ * them adds every shard up, which is the only time they're ever looked at
+ * together; see prometheus().
+ *
+ * @par
+ * Shards are added as workers are made, before any of them start, and never
+ * go away. A worker thread finds its own with local().
+ *
+ * @par
+ * Counts kept somewhere else, once for the whole server, are added the same
+ * way, as a function that reads them when prometheus() is called.
+ */
+class Metrics : boost::noncopyable {
+ public:
+  /// A count with one writer, like Histogram's.
+  class Counter {
+   public:
+    void add(uint64_t n = 1) noexcept {
+      v.store(v.load(std::memory_order_relaxed) + n,
+              std::memory_order_relaxed);
+    }
+    uint64_t value() const noexcept {
+      return v.load(std::memory_order_relaxed);
+    }
+
+   private:
+    std::atomic<uint64_t> v{};
+  };
+
+  /// Microseconds.
+  using Latency = Histogram<>;
+
+  struct alignas(64) Shard : boost::noncopyable {
+    Shard(unsigned _id, size_t mounts)
+        : id{_id}, handler_latency{std::make_unique<Latency[]>(mounts)} {}
+
+    /// In the order they were added.
+    const unsigned id;
+    Counter accepted, closed, handshake_failures, bytes_sent;
+    /// By status code.
+    array<Counter, 70> responses;
+    /// From calling the handler to the last byte of the body, by mount.
+    std::unique_ptr<Latency[]> handler_latency;
+    /// By phase_t.
+    array<Latency, phase_count> phase_latency;
+
+    /// Count how long each phase of a finished connection took.
+    void record(const Trace&) noexcept;
+  };
+
+  /// mounts names each mount point, by the id it's counted under.
+  explicit Metrics(vector<string> mounts);
+
+  /// A new shard. Only before any worker starts.
+  Shard& add_shard();
+
+  /// Export what read() returns as a counter or a gauge. Only before any
+  /// worker starts; read() is then called from whichever thread asks.
+  void add_counter(string name, string help, std::function<uint64_t()> read);
+  void add_gauge(string name, string help, std::function<uint64_t()> read);
+
+  /// Make s what local() returns on this thread.
+  static void bind(Shard& s) noexcept;
+  /// The shard bound to this thread, or nullptr.
+  static Shard* local() noexcept;
+
+  /// Everything so far, in the Prometheus text exposition format.
+  string prometheus() const;
+
+ private:
+  struct Reading {
+    string name, help;
+    bool gauge;
+    std::function<uint64_t()> read;
+  };
+
+  const vector<string> mounts;
+  std::deque<Shard> shards;
+  vector<Reading> readings;
+};
@@ -2,7 +2,9 @@
 #define NET_TYPES_HPP
 
 #define BOOST_ASIO_NO_DEPRECATED
-#define BOOST_ASIO_HAS_IO_URING
+// BOOST_ASIO_HAS_IO_URING and BOOST_ASIO_RECYCLING_ALLOCATOR_CACHE_SIZE
+// change the layout of asio's own classes, so they come from the Makefile,
+// the same for every file, never from here.
 
 #include <boost/asio.hpp>
 #include <boost/core/demangle.hpp>
@@ -42,6 +44,10 @@ using timer = asio::steady_timer::rebind_executor<executor>::other;
 using acceptor = tcp::acceptor::rebind_executor<executor>::other;
 using socket = asio::basic_stream_socket<tcp, executor>;
 using ssl_socket = asio::ssl::stream<socket>;
+using local_acceptor = asio::local::stream_protocol::acceptor::rebind_executor<
+    executor>::other;
+using local_socket = asio::local::stream_protocol::socket::rebind_executor<
+    executor>::other;
 using asio::async_read_until;
 using asio::awaitable;
 using asio::co_spawn;
@@ -1,5 +1,8 @@
+#pragma once
+
 #include <openssl/ssl.h>
 
+#include <string_view>
 #include <type_traits>
 #include <utility>
 
@@ -17,7 +20,7 @@ class Refcnt {
     if (p) UpRef(p);
   }
   Refcnt(const mytype& o) : Refcnt{o.p} {}
-  Refcnt(mytype&& o) : p{std::move(o.p)} {}
+  Refcnt(mytype&& o) : p{std::exchange(o.p, nullptr)} {}
   ~Refcnt() {
     if (p) Free(std::move(p));
   }
@@ -54,6 +57,9 @@ class Session {
    */
   const char* hostname() { return SSL_SESSION_get0_hostname(*p); }
 
+  /// The underlying SSL_SESSION*, still owned by this object.
+  SSL_SESSION* native_handle() { return *p; }
+
  private:
   ptr_t p;
 };
@@ -96,4 +102,23 @@ class Ssl {
   ptr_t p;
 };
 
-}  // namespace openssl
\ No newline at end of file
+/**
+ * The host name a ClientHello asks for with SNI, or empty if none. It's for
+ * a client hello callback, which runs before OpenSSL has parsed anything,
+ * SNI included, and before it looks for a session to resume.
+ */
+inline std::string_view client_hello_servername(SSL* ssl) {
+  const unsigned char* p;
+  size_t len;
+  if (!SSL_client_hello_get0_ext(ssl, TLSEXT_TYPE_server_name, &p, &len))
+    return {};
+  // The list's length, then one name: its type, its length and itself.
+  if (len < 5 || (p[0] << 8 | p[1]) + 2u != len ||
+      p[2] != TLSEXT_NAMETYPE_host_name)
+    return {};
+  size_t n = p[3] << 8 | p[4];
+  if (n + 5 > len) return {};
+  return {reinterpret_cast<const char*>(p + 5), n};
+}
+
+}  // namespace openssl
@@ -0,0 +1,241 @@
+#include "percent.hpp"
+
+#include <bit>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace url {
+namespace detail {
+namespace {
+
+constexpr string_view urlchars{
+    "!$&'()*+,-./"
+    "0123456789:;=?@ABCDEFGHIJKLMNOPQRSTUVWXYZ_~abcdefghijklmnopqrstuvwxyz"};
+constexpr string_view path_urlchars{
+    "!$&'()*+,-./"
+    "0123456789:;=@ABCDEFGHIJKLMNOPQRSTUVWXYZ_~abcdefghijklmnopqrstuvwxyz"};
+constexpr string_view query_urlchars{
+    "!$'()*+,-./"
+    "0123456789:;=?@ABCDEFGHIJKLMNOPQRSTUVWXYZ_~abcdefghijklmnopqrstuvwxyz"};
+
+constexpr string_view chars_for(charset allowed) {
+  switch (allowed) {
+    case charset::path:
+      return path_urlchars;
+    case charset::query:
+      return query_urlchars;
+    default:
+      return urlchars;
+  }
+}
+
+/// table[c] is true if c is left alone by encode().
+using table_t = array<bool, 256>;
+
+constexpr table_t make_table(charset allowed) {
+  table_t t{};
+  for (unsigned char c : chars_for(allowed)) t[c] = true;
+  return t;
+}
+
+constexpr array<table_t, 3> tables{make_table(charset::uri),
+                                   make_table(charset::path),
+                                   make_table(charset::query)};
+
+constexpr const table_t &allowed_table(charset allowed) {
+  return tables[static_cast<size_t>(allowed)];
+}
+
+/// hexval[c] is the value of the hex digit c, or -1.
+constexpr array<int8_t, 256> hexval = [] {
+  array<int8_t, 256> t;
+  t.fill(-1);
+  for (int i = 0; i < 10; ++i) t['0' + i] = i;
+  for (int i = 0; i < 6; ++i) t['a' + i] = t['A' + i] = 10 + i;
+  return t;
+}();
+
+constexpr char hexdigits[]{"0123456789abcdef"};
+
+/// Writes c as a % sequence and returns the new end of out.
+inline char *escape(char c, char *out) {
+  auto u{static_cast<unsigned char>(c)};
+  out[0] = '%';
+  out[1] = hexdigits[u >> 4];
+  out[2] = hexdigits[u & 0xf];
+  return out + 3;
+}
+
+/// Decodes the % sequence at p, or returns -1 if it's malformed.
+inline int unescape(const char *p) {
+  auto hi{hexval[static_cast<unsigned char>(p[1])]},
+      lo{hexval[static_cast<unsigned char>(p[2])]};
+  return (hi | lo) < 0 ? -1 : hi << 4 | lo;
+}
+
+std::variant<size_t, std::errc> decode_scalar(string_view in, char *out) {
+  const auto start{out};
+
+  for (;;) {
+    auto right{in.find('%')};
+    auto run{in.substr(0, right)};
+    // Decoding in place, out trails in, so the copy can overlap.
+    if (out != run.data()) std::memmove(out, run.data(), run.length());
+    out += run.length();
+
+    if (right == string_view::npos)
+      // No more '%' escapes
+      return static_cast<size_t>(out - start);
+
+    in.remove_prefix(right);
+    if (in.length() < 3)
+      // Invalid; truncated % at end
+      return std::errc::invalid_argument;
+
+    auto val{unescape(in.data())};
+    if (val < 0) return std::errc::invalid_argument;
+    *out++ = static_cast<char>(val);
+    in.remove_prefix(3);
+  }
+}
+
+size_t encode_scalar(string_view in, char *out, charset allowed) {
+  const auto &ok{allowed_table(allowed)};
+  const auto start{out};
+  for (auto c : in) {
+    if (ok[static_cast<unsigned char>(c)])
+      *out++ = c;
+    else
+      out = escape(c, out);
+  }
+  return out - start;
+}
+
+#if defined(__x86_64__)
+
+namespace sse2 {
+
+constexpr size_t width{16};
+
+inline uint32_t percents(const char *p) {
+  auto v{_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))};
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('%')));
+}
+
+// SSE2 has no byte shuffle to look chars up in a table, so this only clears
+// the chars that every charset allows and that make up most URLs: [-./0-9],
+// letters, '_' and '~'. Anything else gets checked one at a time.
+inline uint32_t escapes(const char *p, charset) {
+  auto v{_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))};
+  auto in = [&](char lo, char hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)),
+                         _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1)));
+  };
+  auto safe{_mm_or_si128(
+      _mm_or_si128(in('-', '9'), in('A', 'Z')),
+      _mm_or_si128(in('a', 'z'),
+                   _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('_')),
+                                _mm_cmpeq_epi8(v, _mm_set1_epi8('~')))))};
+  return ~_mm_movemask_epi8(safe) & 0xffff;
+}
+
+#include "percent.ipp"
+
+}  // namespace sse2
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+namespace avx2 {
+
+constexpr size_t width{32};
+
+/**
+ * nibble_rows(allowed)[lo] has bit hi set if the char (hi << 4 | lo) is
+ * allowed. Every allowed char is ASCII, so hi < 8 and it fits in a byte.
+ */
+constexpr array<uint8_t, 16> nibble_rows(charset allowed) {
+  array<uint8_t, 16> rows{};
+  for (unsigned char c : chars_for(allowed)) rows[c & 0xf] |= 1 << (c >> 4);
+  return rows;
+}
+
+alignas(16) constexpr array<array<uint8_t, 16>, 3> rows{
+    nibble_rows(charset::uri), nibble_rows(charset::path),
+    nibble_rows(charset::query)};
+
+inline uint32_t percents(const char *p) {
+  auto v{_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p))};
+  return _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('%')));
+}
+
+// An exact lookup: the low nibble of each char picks its row of the table,
+// the high nibble picks the bit in that row. Non-ASCII chars pick no bit.
+inline uint32_t escapes(const char *p, charset allowed) {
+  auto v{_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p))};
+  auto table{_mm256_broadcastsi128_si256(_mm_load_si128(
+      reinterpret_cast<const __m128i *>(rows[static_cast<size_t>(allowed)]
+                                            .data())))};
+  auto bits{_mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0,
+                             0, 0, 1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0,
+                             0, 0, 0, 0)};
+  auto nibble{_mm256_set1_epi8(0xf)};
+  auto lo{_mm256_and_si256(v, nibble)};
+  auto hi{_mm256_and_si256(_mm256_srli_epi16(v, 4), nibble)};
+  auto hits{_mm256_and_si256(_mm256_shuffle_epi8(table, lo),
+                             _mm256_shuffle_epi8(bits, hi))};
+  return _mm256_movemask_epi8(
+      _mm256_cmpeq_epi8(hits, _mm256_setzero_si256()));
+}
+
+#include "percent.ipp"
+
+}  // namespace avx2
+
+#pragma GCC pop_options
+
+const codec all_codecs[]{
+    {"scalar", decode_scalar, encode_scalar},
+    {"sse2", sse2::decode, sse2::encode},
+    {"avx2", avx2::decode, avx2::encode},
+};
+
+size_t supported_codecs() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") ? 3 : 2;
+}
+
+#else
+
+const codec all_codecs[]{{"scalar", decode_scalar, encode_scalar}};
+
+size_t supported_codecs() { return 1; }
+
+#endif
+
+const codec &best_codec() {
+  static const auto &c{codecs().back()};
+  return c;
+}
+
+}  // namespace
+
+span<const codec> codecs() {
+  static const auto n{supported_codecs()};
+  return {all_codecs, n};
+}
+
+}  // namespace detail
+
+std::variant<size_t, std::errc> decode(string_view in, char *out) {
+  return detail::best_codec().decode(in, out);
+}
+
+size_t encode(string_view in, char *out, charset allowed) {
+  return detail::best_codec().encode(in, out, allowed);
+}
+
+}  // namespace url
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "uri.hpp"
+
+namespace url::detail {
+
+/**
+ * codec is one implementation of the % encoding kernels behind url::decode()
+ * and url::encode(). Which one those use is picked at startup from what the
+ * CPU supports; codecs() lists all of them so tests and benchmarks can
+ * compare them.
+ */
+struct codec {
+  const char *name;
+  std::variant<size_t, std::errc> (*decode)(string_view in, char *out);
+  size_t (*encode)(string_view in, char *out, charset allowed);
+};
+
+/// The codecs this CPU can run, slowest (the scalar one) first.
+span<const codec> codecs();
+
+}  // namespace url::detail
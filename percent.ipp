@@ -0,0 +1,70 @@
+// % encoding kernels that work on blocks of `width` bytes at a time.
+//
+// percent.cpp includes this once per instruction set, inside a namespace
+// that provides:
+//
+// - width: the block size in bytes, at most 32
+// - percents(p): a mask with bit i set if p[i] == '%'
+// - escapes(p, allowed): a mask with bit i set if p[i] might need escaping;
+//   it can be coarse, since every hit is double-checked
+//
+// and under a #pragma GCC target for that instruction set, so that all of
+// this is compiled for it and the classifiers inline.
+
+std::variant<size_t, std::errc> decode(string_view in, char *out) {
+  const auto start{out};
+  auto p{in.data()};
+  const auto end{p + in.length()};
+
+  while (static_cast<size_t>(end - p) >= width) {
+    size_t pos{};
+    for (auto m{percents(p)}; m;) {
+      auto k{static_cast<size_t>(std::countr_zero(m))};
+      std::memmove(out, p + pos, k - pos);
+      out += k - pos;
+
+      if (end - (p + k) < 3) return std::errc::invalid_argument;
+      auto val{unescape(p + k)};
+      if (val < 0) return std::errc::invalid_argument;
+      *out++ = static_cast<char>(val);
+
+      // The escape may run into the next block.
+      pos = k + 3;
+      if (pos >= width) break;
+      m &= ~uint32_t{} << pos;
+    }
+    if (pos < width) {
+      std::memmove(out, p + pos, width - pos);
+      out += width - pos;
+      pos = width;
+    }
+    p += pos;
+  }
+
+  auto res{decode_scalar({p, end}, out)};
+  if (res.index() == 1) return res;
+  return static_cast<size_t>(out - start) + std::get<0>(res);
+}
+
+size_t encode(string_view in, char *out, charset allowed) {
+  const auto &ok{allowed_table(allowed)};
+  const auto start{out};
+  auto p{in.data()};
+  const auto end{p + in.length()};
+
+  for (; static_cast<size_t>(end - p) >= width; p += width) {
+    size_t pos{};
+    for (auto m{escapes(p, allowed)}; m; m &= m - 1) {
+      auto k{static_cast<size_t>(std::countr_zero(m))};
+      if (ok[static_cast<unsigned char>(p[k])]) continue;
+      std::memcpy(out, p + pos, k - pos);
+      out = escape(p[k], out + (k - pos));
+      pos = k + 1;
+    }
+    std::memcpy(out, p + pos, width - pos);
+    out += width - pos;
+  }
+
+  return static_cast<size_t>(out - start) +
+         encode_scalar({p, end}, out, allowed);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+/**
+ * USDT probes, so perf and bpftrace can attach to a running server. Where
+ * <sys/sdt.h> is available each one is a nop and a note in the ELF, and
+ * costs nothing until something attaches; elsewhere they're nothing at all,
+ * arguments included. bpftrace/ has scripts that use them.
+ *
+ * @par
+ * The probes, all under the provider "castor". conn is the connection's
+ * socket fd, which is unique among open connections:
+ * - accept(conn, worker)
+ * - handshake_start(conn), handshake_end(conn, ok)
+ * - request(conn, path, path_length)
+ * - route(path, path_length, mount id, or -1 for none)
+ * - header(conn, status)
+ * - file_chunk(conn, file fd, offset, length)
+ * - close(conn, status, or 0 if there was no response)
+ */
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define CASTOR_PROBE(name, ...) STAP_PROBEV(castor, name, __VA_ARGS__)
+#else
+#define CASTOR_PROBE(name, ...) \
+  do {                          \
+  } while (0)
+#endif
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <boost/core/noncopyable.hpp>
+#include <new>
+
+#include "types.hpp"
+
+/**
+ * Recycler keeps freed blocks on a free list instead of handing them back to
+ * malloc, so a thread that keeps making and destroying the same kind of
+ * object stops calling malloc once it has made as many as were ever alive at
+ * once (up to max_free).
+ *
+ * @par
+ * The first allocation fixes the block size; anything bigger or smaller goes
+ * straight to operator new. It isn't thread-safe, so give each thread its
+ * own, and destroy it only after everything it allocated.
+ */
+class Recycler : boost::noncopyable {
+ public:
+  explicit Recycler(size_t max_free = 4096) { free.reserve(max_free); }
+
+  ~Recycler() {
+    for (auto p : free) ::operator delete(p);
+  }
+
+  void* allocate(size_t size) {
+    if (block_size == 0) block_size = size;
+    if (size != block_size) return ::operator new(size);
+    if (free.empty()) return ::operator new(size);
+    auto p{free.back()};
+    free.pop_back();
+    return p;
+  }
+
+  void deallocate(void* p, size_t size) noexcept {
+    if (size == block_size && free.size() < free.capacity())
+      free.push_back(p);
+    else
+      ::operator delete(p);
+  }
+
+  /// An Allocator for std::allocate_shared and friends.
+  template <typename T>
+  struct allocator {
+    using value_type = T;
+
+    Recycler* r;
+
+    template <typename U>
+    allocator(const allocator<U>& o) noexcept : r{o.r} {}
+    allocator(Recycler* _r) noexcept : r{_r} {}
+
+    T* allocate(size_t n) {
+      return static_cast<T*>(r->allocate(n * sizeof(T)));
+    }
+    void deallocate(T* p, size_t n) noexcept { r->deallocate(p, n * sizeof(T)); }
+
+    template <typename U>
+    bool operator==(const allocator<U>& o) const noexcept {
+      return r == o.r;
+    }
+  };
+
+  template <typename T = std::byte>
+  allocator<T> get_allocator() noexcept {
+    return {this};
+  }
+
+ private:
+  size_t block_size{};
+  // Reserved up front, so recycling a block never allocates.
+  vector<void*> free;
+};
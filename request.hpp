@@ -2,7 +2,13 @@
 
 #include "uri.hpp"
 
+/**
+ * Request views into the client's request buffer, so it's only valid while
+ * the client is.
+ */
 struct Request {
-  url::Uri uri;
-  std::filesystem::path path_info;
-};
\ No newline at end of file
+  url::UriView uri;
+  /// The rest of uri.path() after the handler's mount point, starting with
+  /// '/'.
+  string_view path_info;
+};
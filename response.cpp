@@ -1,27 +1,155 @@
 #include "response.hpp"
 
+#include <algorithm>
 #include <array>
-#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
 
-Response::Response(ssl_socket& _s) : socket{_s} {}
+#include "probes.hpp"
 
-const char CRLF[]={'\r','\n'};
+Response::Response(ssl_socket& _s, BufferPool& _pool,
+                   std::pmr::memory_resource* mr)
+    : socket{_s}, pool{_pool}, meta_storage{mr} {}
 
-awaitable<void> Response::flush_header() {
-  if (committed) co_return;
-  auto [cat, code] = std::div(static_cast<int>(this->code), 10);
+namespace {
 
-  array<char, 3> codebuf{static_cast<char>('0' + cat), static_cast<char>('0' + code), ' '};
+const char CRLF[]={'\r','\n'};
 
-  auto buffers = {asio::buffer(codebuf.cbegin(), codebuf.size()),
-                  asio::buffer(string_view{meta}),
-                  asio::buffer(CRLF)};
+// "NN " for every code that fits in two digits.
+constexpr auto status_prefixes = [] {
+  array<array<char, 3>, 100> t{};
+  for (int i = 0; i < 100; ++i)
+    t[i] = {static_cast<char>('0' + i / 10), static_cast<char>('0' + i % 10),
+            ' '};
+  return t;
+}();
 
-  co_await asio::async_write(socket, buffers);
-  committed = true;
+constexpr bool well_formed(string_view line) {
+  return line.size() >= 5 && line[0] >= '1' && line[0] <= '6' &&
+         line[1] >= '0' && line[1] <= '9' && line[2] == ' ' &&
+         line.ends_with("\r\n") &&
+         line.find_first_of("\r\n") == line.size() - 2;
 }
 
+static_assert(std::ranges::all_of(Response::canned_headers, well_formed));
+
+}  // namespace
+
 void Response::header(code_t c, string_view m) {
+  if (_committed) throw std::logic_error{"Response header already sent"};
+  // Everything else indexes status_prefixes with it.
+  if (static_cast<int>(c) < 10 || static_cast<int>(c) > 99)
+    throw std::invalid_argument{"Status code isn't two digits"};
   code = c;
-  meta = m;
-}
\ No newline at end of file
+  auto& prefix{status_prefixes[static_cast<int>(c)]};
+  for (auto line : canned_headers) {
+    if (line.starts_with({prefix.data(), prefix.size()}) &&
+        line.substr(3, line.size() - 5) == m) {
+      canned = line;
+      meta = line.substr(3, line.size() - 5);
+      return;
+    }
+  }
+  canned = {};
+  meta_storage = m.substr(0, max_meta);
+  meta = meta_storage;
+}
+
+string Response::header_line() const {
+  if (!canned.empty()) return string{canned};
+  auto& prefix{status_prefixes[static_cast<int>(code)]};
+  string line{prefix.data(), prefix.size()};
+  line += meta;
+  line.append(CRLF, sizeof CRLF);
+  return line;
+}
+
+// However the header goes out, this is when it's settled.
+void Response::committing() noexcept {
+  _committed = true;
+  CASTOR_PROBE(header, socket.next_layer().native_handle(),
+               static_cast<int>(code));
+}
+
+// Borrow a buffer and put the header at the front of it. It always fits,
+// since meta is at most max_meta bytes.
+awaitable<void> Response::commit_header() {
+  committing();
+  buf = co_await pool.get(record_size);
+  auto p = buf.data();
+  if (!canned.empty()) {
+    p = std::copy(canned.begin(), canned.end(), p);
+  } else {
+    auto& prefix{status_prefixes[static_cast<int>(code)]};
+    p = std::copy(prefix.begin(), prefix.end(), p);
+    p = std::copy(meta.begin(), meta.end(), p);
+    p = std::copy(std::begin(CRLF), std::end(CRLF), p);
+  }
+  buffered = p - buf.data();
+}
+
+// Send what's buffered and give the buffer back until there's more.
+awaitable<void> Response::send_buffer() {
+  co_await asio::async_write(socket, asio::buffer(buf.data(), buffered));
+  progressed(buffered);
+  buffered = 0;
+  buf = {};
+}
+
+// Write data as is, a slice at a time, so a huge write still shows progress.
+awaitable<void> Response::write_through(asio::const_buffer data) {
+  while (data.size() > 0) {
+    auto n = co_await asio::async_write(socket,
+                                        asio::buffer(data, write_slice));
+    data += n;
+    progressed(n);
+  }
+}
+
+awaitable<void> Response::write(asio::const_buffer data) {
+  if (!_committed) co_await commit_header();
+
+  for (;;) {
+    if (!buf) buf = co_await pool.get(record_size);
+    auto n = std::min(data.size(), record_size - buffered);
+    std::memcpy(buf.data() + buffered, data.data(), n);
+    buffered += n;
+    data += n;
+    if (data.size() == 0) co_return;
+
+    // The buffer's full and there's more.
+    co_await send_buffer();
+    if (data.size() >= record_size) {
+      co_await write_through(data);
+      co_return;
+    }
+  }
+}
+
+awaitable<asio::mutable_buffer> Response::prepare() {
+  if (!_committed) co_await commit_header();
+  if (buffered == record_size) co_await send_buffer();
+  if (!buf) buf = co_await pool.get(record_size);
+  co_return asio::buffer(buf.data() + buffered, record_size - buffered);
+}
+
+awaitable<void> Response::flush() {
+  // Nothing but a canned header: send it from where it is.
+  if (!_committed && !canned.empty()) {
+    committing();
+    co_await write_through(asio::buffer(canned.data(), canned.size()));
+    co_return;
+  }
+  if (!_committed) co_await commit_header();
+  if (buffered > 0)
+    co_await send_buffer();
+  else
+    buf = {};
+}
+
+awaitable<void> Response::finish() { co_await flush(); }
+
+awaitable<void> Response::flush_prebuilt(asio::const_buffer data) {
+  committing();
+  co_await write_through(data);
+}
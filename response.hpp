@@ -1,7 +1,20 @@
 #pragma once
 
+#include <memory_resource>
+
+#include "bufferpool.hpp"
 #include "net-types.hpp"
+#include "timerwheel.hpp"
 
+/**
+ * Response is the body of the reply as an async output stream. The first
+ * write (or flush) commits the header; until then header() can still change
+ * it. Writes pile up in a buffer the size of a full TLS record, borrowed
+ * from a BufferPool only while something's in it, and go out when it fills,
+ * so a small page is one record and one syscall, header included. Writes
+ * bigger than the buffer go straight through once it's been topped up and
+ * sent.
+ */
 struct Response {
   enum class category {
     input = 1,
@@ -33,19 +46,104 @@ struct Response {
     certificate_not_valid,
   };
 
-  Response(ssl_socket&);
+  /// The most plaintext a single TLS record carries.
+  static constexpr size_t record_size{16384};
+  /// The longest meta Gemini allows.
+  static constexpr size_t max_meta{1024};
+  /// The most a single write hands the socket before counting as progress.
+  static constexpr size_t write_slice{1 << 18};
+
+  /**
+   * Whole header lines common enough to keep ready-made. header() with one
+   * of these codes and metas points meta at the text here instead of
+   * copying it, and a response that's nothing but the header goes out
+   * straight from here, without borrowing a buffer.
+   */
+  static constexpr array<string_view, 7> canned_headers{
+      "20 text/gemini\r\n",
+      "40 Temporary failure.\r\n",
+      "51 Not found.\r\n",
+      "59 Missing CRLF.\r\n",
+      "59 Request is malformed.\r\n",
+      "59 URL must start with 'gemini:'\r\n",
+      "59 URL must be absolute.\r\n",
+  };
+
+  Response(ssl_socket&, BufferPool&,
+           std::pmr::memory_resource* = std::pmr::get_default_resource());
 
+  /// Only for writing around the buffer, after flush().
   ssl_socket& socket;
-  code_t code;
-  string meta;
+  /// Until header() is called, "40 Temporary failure.".
+  code_t code{code_t::temporary_failure};
+  /// Either one of canned_headers or a copy made by header().
+  string_view meta{canned_headers[1].substr(3, canned_headers[1].size() - 5)};
 
+  /// If set, re-armed to idle_write after every write that gets anywhere,
+  /// so a response only times out when the client stops taking it.
+  TimerWheel::Timer* deadline{};
+  TimerWheel::clock::duration idle_write{};
+
+  /// Bodies that write around the buffer call this after each write, with
+  /// how much it sent.
+  void progressed(size_t n) noexcept {
+    _bytes_sent += n;
+    if (deadline) deadline->arm(idle_write);
+  }
+
+  /// Everything sent so far, header included.
+  uint64_t bytes_sent() const noexcept { return _bytes_sent; }
+
+  /// Set the header. Throws std::logic_error once it's committed, and
+  /// std::invalid_argument for a code that isn't two digits.
   void header(code_t, string_view);
 
-  // TODO: automate committing the response.  Need Response to be async
-  // writeable.  As it is, Handler can write to this->socket interleaved with
-  // methods of this.
-  awaitable<void> flush_header();
+  /// The header line for the current code and meta, including CRLF.
+  string header_line() const;
+
+  /// Append to the body.
+  awaitable<void> write(asio::const_buffer);
+  awaitable<void> write(string_view s) {
+    return write(asio::buffer(s.data(), s.size()));
+  }
+
+  /**
+   * prepare() and commit(n) let a body read straight into the buffer:
+   * prepare() returns the free space at the end of it (sending it first if
+   * it's full), and commit(n) appends the first n bytes of that space.
+   */
+  awaitable<asio::mutable_buffer> prepare();
+  void commit(size_t n) noexcept { buffered += n; }
+
+  /// Send everything written so far, and the header if it hasn't been.
+  awaitable<void> flush();
+
+  /// Flush, and that's the whole response. Client calls this for you.
+  awaitable<void> finish();
+
+  /// Send a buffer that already starts with header_line() and commit.
+  awaitable<void> flush_prebuilt(asio::const_buffer);
+
+  bool committed() const noexcept { return _committed; }
+
+  /// Where per-request allocations (meta, the Body) come from.
+  std::pmr::memory_resource* memory_resource() const noexcept {
+    return meta_storage.get_allocator().resource();
+  }
 
  private:
-  bool committed{};
+  BufferPool& pool;
+  std::pmr::string meta_storage;
+  // The whole header line, if it's canned.
+  string_view canned{canned_headers[1]};
+  bool _committed{};
+  size_t buffered{};
+  uint64_t _bytes_sent{};
+  // Borrowed from pool only while something's buffered.
+  BufferPool::Buffer buf;
+
+  void committing() noexcept;
+  awaitable<void> commit_header();
+  awaitable<void> send_buffer();
+  awaitable<void> write_through(asio::const_buffer);
 };
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include "resumption.hpp"
+
+#include <openssl/core_names.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+int ex_index() {
+  static const int index{
+      SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr)};
+  return index;
+}
+
+string_view id_of(SSL_SESSION* s) {
+  unsigned len;
+  auto id{SSL_SESSION_get_id(s, &len)};
+  return {reinterpret_cast<const char*>(id), len};
+}
+
+template <typename Key>
+void random_key(Key& k) {
+  if (RAND_bytes(k.name.data(), k.name.size()) <= 0 ||
+      RAND_bytes(k.aes.data(), k.aes.size()) <= 0 ||
+      RAND_bytes(k.hmac.data(), k.hmac.size()) <= 0)
+    throw std::runtime_error{"Couldn't generate a session ticket key"};
+}
+
+}  // namespace
+
+Resumption::Resumption(SSL_CTX* ctx, Options opts)
+    : options{opts},
+      cache{opts.cache_size} {
+  // 0 would expire every session at once, and rotate keys back to back.
+  if (options.lifetime < std::chrono::seconds{1})
+    throw std::invalid_argument{"Session lifetime under a second"};
+  random_key(current);
+  random_key(previous);
+  install(ctx);
+}
+
+void Resumption::install(SSL_CTX* ctx, string_view context) {
+  SSL_CTX_set_ex_data(ctx, ex_index(), this);
+  SSL_CTX_set_timeout(ctx, options.lifetime.count());
+  // OpenSSL checks it on every resumption, sessions from the cache and
+  // tickets alike. It's at most 32 bytes, so the context goes in hashed.
+  array<unsigned char, SSL_MAX_SID_CTX_LENGTH> sid_ctx;
+  unsigned len;
+  if (!EVP_Digest(context.data(), context.size(), sid_ctx.data(), &len,
+                  EVP_sha256(), nullptr) ||
+      !SSL_CTX_set_session_id_context(ctx, sid_ctx.data(), len))
+    throw std::runtime_error{"Couldn't set the session id context"};
+
+  switch (options.mode) {
+    case mode_t::off:
+      SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+      SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+      SSL_CTX_set_num_tickets(ctx, 0);
+      break;
+    case mode_t::cache:
+      // OpenSSL's own cache is one table behind one lock; use ours instead.
+      SSL_CTX_set_session_cache_mode(
+          ctx, SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL);
+      SSL_CTX_sess_set_new_cb(ctx, new_session);
+      SSL_CTX_sess_set_get_cb(ctx, get_session);
+      SSL_CTX_sess_set_remove_cb(ctx, remove_session);
+      // With tickets off, TLS 1.3 still sends a ticket, but it only names a
+      // session in the cache.
+      SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+      SSL_CTX_set_num_tickets(ctx, 1);
+      break;
+    case mode_t::tickets:
+      SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+      SSL_CTX_clear_options(ctx, SSL_OP_NO_TICKET);
+      SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, ticket_key);
+      // Clients only need one, since each is good for a whole lifetime.
+      SSL_CTX_set_num_tickets(ctx, 1);
+      break;
+  }
+}
+
+Resumption::~Resumption() {
+  OPENSSL_cleanse(&current, sizeof current);
+  OPENSSL_cleanse(&previous, sizeof previous);
+}
+
+void Resumption::rotate_keys() {
+  TicketKey fresh;
+  random_key(fresh);
+  std::scoped_lock lock{key_mutex};
+  previous = current;
+  current = fresh;
+  OPENSSL_cleanse(&fresh, sizeof fresh);
+}
+
+void Resumption::handshake_done(SSL* ssl) noexcept {
+  (SSL_session_reused(ssl) ? _resumed : _full)
+      .fetch_add(1, std::memory_order_relaxed);
+}
+
+void Resumption::insert(SSL_SESSION* sess) {
+  cache.insert(string{id_of(sess)}, openssl::Session{sess});
+}
+
+SSL_SESSION* Resumption::find(string_view id) {
+  auto sess{cache.find(id)};
+  if (!sess) return nullptr;
+  // The caller's reference; ours goes when sess does.
+  SSL_SESSION_up_ref(sess->native_handle());
+  return sess->native_handle();
+}
+
+void Resumption::erase(string_view id) { cache.erase(id); }
+
+Resumption& Resumption::from(SSL_CTX* ctx) {
+  return *static_cast<Resumption*>(SSL_CTX_get_ex_data(ctx, ex_index()));
+}
+
+int Resumption::new_session(SSL* ssl, SSL_SESSION* sess) {
+  from(SSL_get_SSL_CTX(ssl)).insert(sess);
+  // The cache took its own reference.
+  return 0;
+}
+
+SSL_SESSION* Resumption::get_session(SSL* ssl, const unsigned char* id,
+                                     int len, int* copy) {
+  // find() already took the reference OpenSSL will own.
+  *copy = 0;
+  return from(SSL_get_SSL_CTX(ssl))
+      .find({reinterpret_cast<const char*>(id), static_cast<size_t>(len)});
+}
+
+void Resumption::remove_session(SSL_CTX* ctx, SSL_SESSION* sess) {
+  from(ctx).erase(id_of(sess));
+}
+
+/*
+ * Returns 1 to use the key, 2 to accept a ticket but issue a new one under
+ * the current key, 0 to ignore a ticket and do a full handshake, or -1 on
+ * error.
+ */
+int Resumption::ticket_key(SSL* ssl, unsigned char* name, unsigned char* iv,
+                           EVP_CIPHER_CTX* cctx, EVP_MAC_CTX* hctx, int enc) {
+  auto& self{from(SSL_get_SSL_CTX(ssl))};
+  TicketKey key;
+  bool is_current{true};
+  {
+    std::scoped_lock lock{self.key_mutex};
+    if (enc) {
+      key = self.current;
+    } else if (std::equal(self.current.name.begin(), self.current.name.end(),
+                          name)) {
+      key = self.current;
+    } else if (std::equal(self.previous.name.begin(),
+                          self.previous.name.end(), name)) {
+      key = self.previous;
+      is_current = false;
+    } else {
+      return 0;
+    }
+  }
+
+  auto cipher{EVP_aes_256_cbc()};
+  if (enc) {
+    std::ranges::copy(key.name, name);
+    if (RAND_bytes(iv, EVP_CIPHER_get_iv_length(cipher)) <= 0) return -1;
+  }
+
+  OSSL_PARAM params[]{
+      OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key.hmac.data(),
+                                        key.hmac.size()),
+      OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+                                       const_cast<char*>("SHA256"), 0),
+      OSSL_PARAM_construct_end()};
+  auto ok{EVP_MAC_CTX_set_params(hctx, params) &&
+          EVP_CipherInit_ex(cctx, cipher, nullptr, key.aes.data(), iv, enc)};
+  OPENSSL_cleanse(&key, sizeof key);
+  if (!ok) return -1;
+  return is_current ? 1 : 2;
+}
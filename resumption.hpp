@@ -0,0 +1,89 @@
+#pragma once
+
+#include <openssl/ssl.h>
+
+#include <atomic>
+#include <boost/core/noncopyable.hpp>
+#include <chrono>
+#include <mutex>
+
+#include "lru.hpp"
+#include "openssl.hpp"
+#include "types.hpp"
+
+/**
+ * Resumption lets returning clients skip the expensive part of the TLS
+ * handshake. Gemini opens a connection per request, so a client browsing a
+ * capsule can resume on nearly every request after its first.
+ *
+ * @par
+ * It installs itself on an SSL_CTX in one of two modes:
+ *  - tickets: the session goes back to the client encrypted under a key only
+ *    the server knows, so the server keeps no state. rotate_keys() replaces
+ *    the key; tickets under the previous key still work (and are reissued)
+ *    until the next rotation.
+ *  - cache: the server keeps sessions in memory and the client only gets an
+ *    id. The cache is split into shards, each with its own lock and LRU list,
+ *    so worker threads rarely wait on each other.
+ *
+ * It's safe to use from any thread.
+ */
+class Resumption : boost::noncopyable {
+ public:
+  enum class mode_t { off, cache, tickets };
+
+  struct Options {
+    mode_t mode{mode_t::tickets};
+    /// How long a session can be resumed, and how often ticket keys rotate;
+    /// at least a second.
+    std::chrono::seconds lifetime{std::chrono::hours{1}};
+    /// Sessions kept in cache mode, across all shards.
+    size_t cache_size{1 << 16};
+  };
+
+  /// Installs on the SSL_CTX with the default context.
+  Resumption(SSL_CTX*, Options);
+  ~Resumption();
+
+  const Options options;
+
+  /// Install on another SSL_CTX as well, say one with a renewed
+  /// certificate. A session only resumes on an SSL_CTX installed with the
+  /// same context as the one it was made on, so with each virtual host's
+  /// installed under its name, sessions don't cross hosts.
+  void install(SSL_CTX*, string_view context = "castor");
+
+  /// Start encrypting tickets under a new key.
+  void rotate_keys();
+
+  /// Count a finished server handshake as resumed or full.
+  void handshake_done(SSL*) noexcept;
+  uint64_t resumed() const noexcept { return _resumed.load(); }
+  uint64_t full() const noexcept { return _full.load(); }
+
+ private:
+  struct TicketKey {
+    array<unsigned char, 16> name;
+    array<unsigned char, 32> aes, hmac;
+  };
+
+  std::mutex key_mutex;
+  TicketKey current, previous;
+
+  // Keyed by session id.
+  ShardedLru<openssl::Session> cache;
+
+  std::atomic<uint64_t> _resumed{}, _full{};
+
+  void insert(SSL_SESSION*);
+  SSL_SESSION* find(string_view id);
+  void erase(string_view id);
+
+  // OpenSSL callbacks; they find the Resumption through the SSL_CTX.
+  static Resumption& from(SSL_CTX*);
+  static int new_session(SSL*, SSL_SESSION*);
+  static SSL_SESSION* get_session(SSL*, const unsigned char*, int, int*);
+  static void remove_session(SSL_CTX*, SSL_SESSION*);
+  static int ticket_key(SSL*, unsigned char*, unsigned char*, EVP_CIPHER_CTX*,
+                        EVP_MAC_CTX*, int);
+};
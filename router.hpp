@@ -0,0 +1,138 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <optional>
+
+#include "types.hpp"
+
+/**
+ * Router maps absolute paths to values by their longest mounted prefix.
+ * Prefixes match whole path segments: a value mounted at /a matches /a, /a/
+ * and /a/b/c, but not /ab.
+ *
+ * @par
+ * It's a radix trie over path segments, built once up front. Runs of
+ * segments with nothing mounted in between are collapsed into a single edge,
+ * and each node's children are sorted by their first segment, so a lookup is
+ * a binary search per edge and never allocates. It's read-only once built,
+ * so any number of threads can share it.
+ */
+template <typename T>
+class Router {
+ public:
+  struct Match {
+    std::reference_wrapper<const T> value;
+    /// The part of the path after the mount point, starting with '/'. This
+    /// views into the path passed to find(), except when the path is exactly
+    /// the mount point, where it's a static "/".
+    string_view path_info;
+  };
+
+  Router() = default;
+
+  /// Mount each value at its key. Keys must be absolute paths.
+  explicit Router(const std::map<std::filesystem::path, T>& routes) {
+    Builder b;
+    for (auto& [k, v] : routes) {
+      auto* n = &b;
+      for (auto seg : segments(k.native())) {
+        n = &n->children[string{seg}];
+      }
+      n->value = v;
+    }
+    root.value = std::move(b.value);
+    for (auto& [label, child] : b.children) {
+      root.children.push_back(compile(label, std::move(child)));
+    }
+  }
+
+  /**
+   * find(path) finds the value with the longest mount point that is a prefix
+   * of path. path must be absolute and lexically normal.
+   */
+  std::optional<Match> find(string_view path) const noexcept {
+    if (!path.starts_with('/')) return {};
+
+    const T* best = root.value ? &*root.value : nullptr;
+    // path[best_end] is the '/' after the best mount point, or the end.
+    size_t best_end{};
+
+    const Node* n = &root;
+    for (size_t pos{}; pos < path.length();) {
+      auto rest = path.substr(pos + 1);
+      auto seg = rest.substr(0, rest.find('/'));
+      auto it = std::ranges::lower_bound(n->children, seg, {},
+                                         &Node::first_segment);
+      if (it == n->children.end() || it->first_segment() != seg) break;
+      // Only one child can start with seg, so if the rest of its label
+      // doesn't match, nothing below here does.
+      auto& label = it->label;
+      if (!rest.starts_with(label) ||
+          (rest.length() > label.length() && rest[label.length()] != '/'))
+        break;
+
+      pos += 1 + label.length();
+      n = &*it;
+      if (n->value) {
+        best = &*n->value;
+        best_end = pos;
+      }
+    }
+
+    if (!best) return {};
+    auto info = path.substr(best_end);
+    return Match{*best, info.empty() ? "/"sv : info};
+  }
+
+ private:
+  struct Node {
+    // One or more segments joined by '/', with no leading or trailing '/'.
+    string label;
+    // Length of label's first segment.
+    size_t first;
+    std::optional<T> value;
+    // Sorted by first_segment().
+    vector<Node> children;
+
+    string_view first_segment() const noexcept {
+      return string_view{label}.substr(0, first);
+    }
+  };
+
+  // Uncompressed trie, one segment per node, used while building.
+  struct Builder {
+    std::optional<T> value;
+    std::map<string, Builder> children;
+  };
+
+  Node root{};
+
+  static vector<string_view> segments(string_view p) {
+    vector<string_view> segs;
+    while (!p.empty()) {
+      auto slash = p.find('/');
+      if (slash != 0) segs.push_back(p.substr(0, slash));
+      if (slash == string_view::npos) break;
+      p.remove_prefix(slash + 1);
+    }
+    return segs;
+  }
+
+  static Node compile(string label, Builder&& b) {
+    Node n{label, label.length(), {}, {}};
+    // Fold in single children until we reach a mount point or a fork.
+    while (!b.value && b.children.size() == 1) {
+      auto child = std::move(b.children.begin()->second);
+      n.label += '/';
+      n.label += b.children.begin()->first;
+      b = std::move(child);
+    }
+    n.value = std::move(b.value);
+    for (auto& [l, child] : b.children) {
+      n.children.push_back(compile(l, std::move(child)));
+    }
+    return n;
+  }
+};
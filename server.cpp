@@ -1,6 +1,18 @@
 #include "server.hpp"
 
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <set>
+
+#include "handoff.hpp"
+#include "handler/metrics.hpp"
+#include "log.hpp"
+#include "probes.hpp"
 
 namespace {
 
@@ -40,152 +52,584 @@ void report_sock_opts(const acceptor& sock) {
   report_sock_opt<acceptor::send_low_watermark>(sock, "send_low_watermark");
 }
 
+using reuse_port =
+    asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+
+void pin_to_cpu(unsigned n) {
+  auto ncpus = std::thread::hardware_concurrency();
+  if (ncpus == 0) return;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(n % ncpus, &set);
+  if (auto e = pthread_setaffinity_np(pthread_self(), sizeof set, &set); e) {
+    cerr << "Couldn't pin worker " << n << ": " << std::strerror(e) << '\n';
+  }
+}
+
+// Every mount point, in the order their ids are given out.
+vector<std::filesystem::path> mount_points(
+    const std::map<std::filesystem::path, Handler>& handlers,
+    const std::filesystem::path& metrics_route) {
+  std::set<std::filesystem::path> points;
+  for (auto& [p, h] : handlers) points.insert(p);
+  if (!metrics_route.empty()) points.insert(metrics_route);
+  return {points.begin(), points.end()};
+}
+
+// Then each virtual host's, named after it. The metrics route is the same
+// mount on every host.
+vector<string> mount_names(
+    const std::map<std::filesystem::path, Handler>& handlers,
+    const vector<Server::VirtualHost>& hosts,
+    const std::filesystem::path& metrics_route) {
+  vector<string> names;
+  for (auto& p : mount_points(handlers, metrics_route))
+    names.push_back(p.native());
+  for (auto& host : hosts)
+    for (auto& [p, h] : host.handlers)
+      if (p != metrics_route) names.push_back(host.name + p.native());
+  return names;
+}
+
+vector<string> host_names(const vector<Server::VirtualHost>& hosts) {
+  vector<string> names;
+  for (auto& h : hosts) names.push_back(h.name);
+  return names;
+}
+
+vector<std::function<ssl::context()>> host_contexts(
+    const vector<Server::VirtualHost>& hosts) {
+  vector<std::function<ssl::context()>> contexts;
+  for (auto& h : hosts) contexts.push_back(h.tls);
+  return contexts;
+}
+
+// The servername callback on each host's context.
+int ack_host(SSL*, int*, void*) { return SSL_TLSEXT_ERR_OK; }
+
+// Write to the side and rename, so a reader never sees half a file.
+void replace_file(const std::filesystem::path& path, string_view contents) {
+  auto tmp{path};
+  tmp += ".tmp";
+  {
+    std::ofstream out{tmp};
+    out << contents << std::flush;
+    if (!out) {
+      logging::log(logging::level::warning, "Couldn't write ", tmp.native());
+      return;
+    }
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmp, path, ec);
+  if (ec)
+    logging::log(logging::level::warning, "Couldn't write ", path.native(),
+                 ": ", ec.message());
+}
+
 }  // namespace
 
+thread_local Server::Worker* Server::Worker::current{};
+
 Server::Server(ssl::context&& ctx,
-               const std::map<std::filesystem::path, Handler>& handlers)
-    : ssl_context{std::move(ctx)}, handlers{handlers}, sock{io} {}
+               const std::map<std::filesystem::path, Handler>& handlers,
+               Options opts, const vector<VirtualHost>& hosts)
+    : options{opts},
+      host_tls{host_contexts(hosts)},
+      hostnames{host_names(hosts)},
+      names{hostnames},
+      tls{make_tls(std::move(ctx))},
+      _resumption{tls->fallback.native_handle(), opts.resumption},
+      _buffers{opts.buffers},
+      _admission{opts.admission},
+      _metrics{mount_names(handlers, hosts, opts.metrics_route)},
+      _traces{opts.tracing.file.empty() ? 0 : opts.tracing.keep} {
+  install(*tls);
+
+  _metrics.add_gauge("castor_buffer_bytes_in_use",
+                     "Bytes of response buffers lent out now.",
+                     [this] { return _buffers.in_use(); });
+  _metrics.add_gauge("castor_buffer_bytes_peak",
+                     "Most bytes of response buffers ever lent out at once.",
+                     [this] { return _buffers.peak(); });
+  _metrics.add_counter("castor_buffer_waits_total",
+                       "Times a response waited for buffers to come back.",
+                       [this] { return _buffers.waits(); });
+  _metrics.add_counter("castor_admission_slowed_total",
+                       "Clients told to slow down.",
+                       [this] { return _admission.slowed(); });
+  _metrics.add_counter("castor_admission_refused_total",
+                       "Connections refused, on accepting or for want of "
+                       "a handshake slot.",
+                       [this] { return _admission.refused(); });
+
+  std::map<std::filesystem::path, Mount> mounts;
+  unsigned id{};
+  std::optional<Mount> metrics_mount;
+  for (auto& p : mount_points(handlers, options.metrics_route)) {
+    // The metrics route wins over a handler mounted at the same place.
+    Handler h{p == options.metrics_route ? Handler{MetricsHandler{_metrics}}
+                                         : handlers.at(p)};
+    auto& m{mounts.emplace(p, Mount{std::move(h), id++}).first->second};
+    if (p == options.metrics_route) metrics_mount = m;
+  }
+  routers.emplace_back(mounts);
+  for (auto& host : hosts) {
+    mounts.clear();
+    for (auto& [p, h] : host.handlers)
+      if (p != options.metrics_route) mounts.emplace(p, Mount{h, id++});
+    if (metrics_mount) mounts.emplace(options.metrics_route, *metrics_mount);
+    routers.emplace_back(mounts);
+  }
+
+  if (options.threads == 0) {
+    options.threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (unsigned i = 0; i < options.threads; ++i) {
+    workers.push_back(std::make_unique<Worker>(*this, i));
+  }
+}
 
 void Server::run() {
-  std::exception_ptr exc;
-  co_spawn(io, do_run(tcp::endpoint{tcp::v4(), 1965}),
-           [&](std::exception_ptr e) { exc = e; });
+  if (!options.handoff.empty()) take_listeners();
 
-  io.run();
+  // Worker 0 runs on the calling thread and also owns signal handling.
+  running = workers.size();
+  vector<std::jthread> threads;
+  for (auto& w : workers | std::views::drop(1)) {
+    threads.emplace_back([&w = *w] { w.run(); });
+  }
+
+  workers[0]->run();
   shutdown();
+  threads.clear();
+
+  logging::log(logging::level::info, "Handshakes: ", _resumption.resumed(),
+               " resumed, ", _resumption.full(), " full");
+  logging::log(logging::level::info, "Buffers: ", _buffers.peak(),
+               " bytes at most, waited ", _buffers.waits(), " times");
+  logging::log(logging::level::info, "Admission: ", _admission.slowed(),
+               " told to slow down, ", _admission.refused(), " refused");
+  // One last time, so the files have the final counts.
+  write_metrics_file();
+  write_trace_file();
+  if (!options.handoff.empty() && !handed_off) {
+    std::error_code ec;
+    std::filesystem::remove(options.handoff, ec);
+  }
 
-  if (exc) {
-    std::rethrow_exception(exc);
+  for (auto& w : workers) {
+    if (w->exc) {
+      std::rethrow_exception(w->exc);
+    }
   }
 }
 
-awaitable<void> Server::do_run(const tcp::endpoint ep) {
-  auto signals = asio::signal_set{io};
-  signals.add(SIGTERM);
-  signals.add(SIGINT);
-  signals.async_wait(std::bind_front(&Server::on_signal, this));
-  sock.open(ep.protocol());
-  sock.set_option(acceptor::reuse_address(true));
-  report_sock_opts(sock);
-  sock.bind(ep);
-  sock.listen();
+Server::Worker::Worker(Server& _server, unsigned _id)
+    : server{_server},
+      id{_id},
+      metrics{_server._metrics.add_shard()},
+      tls{_server.tls},
+      sock{io},
+      key_timer{io},
+      wheel_timer{io},
+      metrics_timer{io},
+      trace_timer{io} {}
 
-  cout << "Listening for connections on " << ep << endl;
+void Server::Worker::run() {
+  if (server.options.pin_threads) {
+    pin_to_cpu(id);
+  }
+  Metrics::bind(metrics);
+  current = this;
+  // Made here, on the thread that uses it, so FileRing::local() finds it.
+  if (server.options.file_ring.enabled) {
+    ring.emplace(io, server.options.file_ring);
+  }
+
+  co_spawn(io, do_run(server.options.endpoint), [&](std::exception_ptr e) {
+    if (e) {
+      exc = e;
+      server.shutdown();
+    }
+  });
 
+  io.run();
+}
+
+awaitable<void> Server::Worker::do_run(const tcp::endpoint ep) {
+  if (id == 0) {
+    signals.emplace(io, SIGTERM, SIGINT, SIGHUP);
+    co_spawn(io, handle_signals(), detached);
+  }
+  if (is_shutdown) {
+    // Server::shutdown() got here before we did.
+    co_return;
+  }
+  co_spawn(io, tick_timers(), detached);
+  if (id == 0 &&
+      server.options.resumption.mode == Resumption::mode_t::tickets) {
+    co_spawn(io, rotate_ticket_keys(), detached);
+  }
+  if (id == 0 && !server.options.metrics_file.empty()) {
+    co_spawn(io, write_metrics(), detached);
+  }
+  if (id == 0 && server._traces.enabled()) {
+    co_spawn(io, write_traces(), detached);
+  }
+  if (id < server.inherited.size()) {
+    // Already bound and listening, and maybe with connections waiting.
+    sock.assign(ep.protocol(), server.inherited[id]);
+    if (id == 0) {
+      report_sock_opts(sock);
+    }
+  } else {
+    sock.open(ep.protocol());
+    sock.set_option(acceptor::reuse_address(true));
+    sock.set_option(reuse_port(true));
+    if (id == 0) {
+      report_sock_opts(sock);
+    }
+    sock.bind(ep);
+    sock.listen();
+  }
+  listen_fd = sock.native_handle();
+  // Those inherited beyond one per worker are shared out among them.
+  for (auto i{server.workers.size() + id}; i < server.inherited.size();
+       i += server.workers.size()) {
+    extra_socks.emplace_back(io, ep.protocol(), server.inherited[i]);
+  }
+  if (id == 0 && !server.options.handoff.empty()) {
+    co_spawn(io, serve_handoff(), detached);
+  }
+
+  logging::log(logging::level::info, "Worker ", id,
+               " listening for connections on ", ep.address().to_string(), ':',
+               ep.port());
+
+  for (auto& extra : extra_socks) co_spawn(io, accept(extra), detached);
+  co_await accept(sock);
+}
+
+awaitable<void> Server::Worker::accept(acceptor& a) {
   try {
     for (;;) {
-      ssl_socket peer{io, ssl_context};
-      cout << "async_accept()" << endl;
-      co_await sock.async_accept(peer.lowest_layer());
-      if (!sock.is_open()) {
+      ssl_socket peer{io, tls->fallback};
+      co_await a.async_accept(peer.lowest_layer());
+      if (!a.is_open()) {
         peer.lowest_layer().close();
         break;
       }
-      auto client = std::make_shared<Client>(*this, std::move(peer));
-      auto sig = std::make_unique<asio::cancellation_signal>();
-      auto& sig_ref = *sig;
-      clients.insert(&sig_ref);
-      co_spawn(io, client->run() || client->timeout(),
-               asio::bind_cancellation_slot(sig_ref.slot(),
-                                            [&, client, sig = std::move(sig)](
-                                                std::exception_ptr e, auto&&) {
-                                              clients.erase(sig.get());
-                                            }));
+      metrics.accepted.add();
+      CASTOR_PROBE(accept, peer.lowest_layer().native_handle(), id);
+      // Turn away what we can't serve before it costs a handshake.
+      err ec;
+      auto ticket = server._admission.admit(
+          peer.lowest_layer().remote_endpoint(ec).address());
+      if (ec || ticket.verdict() == Admission::verdict_t::refuse) {
+        peer.lowest_layer().close(ec);
+        metrics.closed.add();
+        continue;
+      }
+      // The Client unlinks itself from clients when the handler drops it.
+      auto client = std::allocate_shared<Client>(
+          client_pool.get_allocator(), server, std::move(peer),
+          std::move(ticket), wheel);
+      clients.push_back(*client);
+      co_spawn(io, client->run(),
+               asio::bind_cancellation_slot(client->cancel.slot(),
+                                            [client](std::exception_ptr) {}));
     }
   } catch (const system_error& e) {
     if (e.code().value() != asio::error::operation_aborted) {
-      cerr << "Error accepting: " << e.what() << " (" << e.what() << endl;
+      logging::log(logging::level::error, "Error accepting: ", e.what());
       throw;
     }
   } catch (const std::exception& e) {
-    cerr << "Different kind of std::exception: "
-         << boost::core::demangle(typeid(e).name()) << endl;
+    logging::log(logging::level::error, "Different kind of std::exception: ",
+                 boost::core::demangle(typeid(e).name()));
     throw;
   }
 }
 
-void Server::on_signal(err, int sig) {
-  cout << "Received signal " << sig << endl;
-  shutdown();
+awaitable<void> Server::Worker::tick_timers() {
+  for (;;) {
+    wheel_timer.expires_after(wheel.tick());
+    co_await wheel_timer.async_wait();
+    auto now{TimerWheel::clock::now()};
+    wheel.advance(now);
+    if (is_shutdown && (clients.empty() || now >= drain_until)) finish();
+    if (finished) co_return;
+  }
 }
 
-void Server::shutdown() noexcept {
-  if (is_shutdown) {
+awaitable<void> Server::Worker::write_metrics() {
+  for (;;) {
+    metrics_timer.expires_after(server.options.metrics_interval);
+    co_await metrics_timer.async_wait();
+    if (is_shutdown) co_return;
+    server.write_metrics_file();
+  }
+}
+
+awaitable<void> Server::Worker::write_traces() {
+  for (;;) {
+    trace_timer.expires_after(server.options.tracing.interval);
+    co_await trace_timer.async_wait();
+    if (is_shutdown) co_return;
+    server.write_trace_file();
+  }
+}
+
+awaitable<void> Server::Worker::rotate_ticket_keys() {
+  for (;;) {
+    key_timer.expires_after(server.options.resumption.lifetime);
+    co_await key_timer.async_wait();
+    if (is_shutdown) co_return;
+    server._resumption.rotate_keys();
+  }
+}
+
+awaitable<void> Server::Worker::handle_signals() {
+  for (;;) {
+    server.on_signal(co_await signals->async_wait(asio::use_awaitable));
+  }
+}
+
+awaitable<void> Server::Worker::serve_handoff() {
+  // Tell the server we took over from that it can go: we're accepting on
+  // its sockets now, whether or not we can hand them on in turn.
+  if (server.handoff_conn >= 0) {
+    char ready{1};
+    if (::write(server.handoff_conn, &ready, 1) != 1)
+      logging::log(logging::level::warning,
+                   "Couldn't tell the last server to drain");
+    ::close(server.handoff_conn);
+    server.handoff_conn = -1;
+  }
+
+  auto& path{server.options.handoff};
+  std::error_code ec;
+  std::filesystem::remove(path, ec);
+  try {
+    handoff.emplace(io, asio::local::stream_protocol::endpoint{path.native()});
+  } catch (const system_error& e) {
+    // Serving goes on; the next server will have to bind its own sockets.
+    logging::log(logging::level::error, "Can't take handoffs on ",
+                 path.native(), ": ", e.what());
+    co_return;
+  }
+
+  for (;;) {
+    local_socket conn{io};
+    co_await handoff->async_accept(conn);
+    vector<int> fds;
+    for (auto& w : server.workers) {
+      if (auto fd{w->listen_fd.load()}; fd >= 0) fds.push_back(fd);
+    }
+    for (auto i{server.workers.size()}; i < server.inherited.size(); ++i)
+      fds.push_back(server.inherited[i]);
+    try {
+      handoff::send_fds(conn.native_handle(), fds);
+    } catch (const std::system_error& e) {
+      logging::log(logging::level::warning, "Handoff failed: ", e.what());
+      continue;
+    }
+
+    // Keep accepting until the new server says it's accepting too.
+    char ready;
+    err e;
+    co_await conn.async_read_some(
+        asio::buffer(&ready, 1), asio::redirect_error(asio::use_awaitable, e));
+    if (e) {
+      logging::log(logging::level::warning,
+                   "New server went away during handoff; carrying on");
+      continue;
+    }
+    logging::log(logging::level::info, "Handed off ", fds.size(),
+                 " listening sockets");
+    server.handed_off = true;
+    server.shutdown(server.options.drain);
+    co_return;
+  }
+}
+
+void Server::Worker::shutdown(TimerWheel::clock::time_point until) noexcept {
+  if (!is_shutdown) {
+    is_shutdown = true;
+    drain_until = until;
+    try {
+      sock.close();
+      for (auto& extra : extra_socks) extra.close();
+      key_timer.cancel();
+      metrics_timer.cancel();
+      trace_timer.cancel();
+      if (handoff) handoff->close();
+    } catch (...) {
+    }
+  } else {
+    drain_until = std::min(drain_until, until);
+  }
+  // Otherwise tick_timers() keeps an eye on them.
+  if (clients.empty() || TimerWheel::clock::now() >= drain_until) finish();
+}
+
+void Server::Worker::finish() noexcept {
+  if (finished) {
     return;
   }
-  is_shutdown = true;
-  cout << "Shutting down" << endl;
+  finished = true;
   try {
-    sock.close();
+    wheel_timer.cancel();
+    if (ring) ring->close();
   } catch (...) {
   }
 
-  std::ranges::for_each(
-      clients, [](auto ptr) { ptr->emit(asio::cancellation_type::terminal); });
-
+  if (!clients.empty()) {
+    logging::log(logging::level::info, "Worker ", id, " cutting off ",
+                 clients.size(), " connections");
+  }
+  for (auto& c : clients) {
+    c.cancel.emit(asio::cancellation_type::terminal);
+  }
   clients.clear();
+
+  // Worker 0 listens for signals until everyone's done, so a second
+  // SIGTERM can still cut a slow drain short.
+  if (--server.running == 0) {
+    asio::post(server.workers[0]->io, [&w = *server.workers[0]] {
+      err ec;
+      if (w.signals) w.signals->cancel(ec);
+    });
+  }
 }
 
-/*
- * is_parent_path(parent, child) checks if the child path is lexically contained
- * within the parent path. parent and child must both be absolute,
- * lexically-normal paths. The result is undefined otherwise.
- */
-bool is_parent_path(const std::filesystem::path& parent,
-                    const std::filesystem::path& child) {
-  auto &p{parent.native()}, &c{child.native()};
-  // Path p is a 'parent' of c (and x is not) if and only if:
-  // - c has a prefix of p and p ends with a path separator:
-  //   p: /asdf/zxcv/
-  //   c: /asdf/zxcv/qwerty
-  //   x: /asdf/zxcvqwerty
-  // - c has a prefix of p and the next character after the prefix
-  //   is the path separator or the end of the string:
-  //   p: /asdf/zxcv
-  //   c: /asdf/zxcv/qwerty
-  //   c: /asdf/zxcv
-  //   x: /asdf/zxcvqwerty
-  if (!c.starts_with(p)) {
-    return false;
-  }
-  if (p.ends_with(std::filesystem::path::preferred_separator)) {
-    return true;
-  }
-  string_view rest{c.begin() + p.length(), c.end()};
-  return rest.starts_with(std::filesystem::path::preferred_separator);
-}
-
-/*
- * relative_path(parent, child) returns the portion of child following parent if
- * child is relative to child, or nothing. parent and child must both be
- * absolute, lexically-normal paths. The result is undefined otherwise.
- */
-std::optional<std::filesystem::path> relative_path(
-    const std::filesystem::path& parent, const std::filesystem::path& child) {
-  auto &p{parent.native()}, &c{child.native()};
-  if (!c.starts_with(p)) {
-    return {};
-  }
-  string_view rest;
-  if (p.ends_with(std::filesystem::path::preferred_separator)) {
-    rest = {c.begin() + p.length() - 1, c.end()};
-  } else {
-    rest = {c.begin() + p.length(), c.end()};
-    if (!rest.starts_with(std::filesystem::path::preferred_separator)) {
-      return {};
+void Server::on_signal(int sig) {
+  logging::log(logging::level::info, "Received signal ", sig);
+  switch (sig) {
+    case SIGHUP:
+      reload_tls();
+      break;
+    case SIGTERM:
+      // A second one doesn't wait.
+      shutdown(is_shutdown ? std::chrono::seconds{} : options.drain);
+      break;
+    default:
+      shutdown();
+  }
+}
+
+std::shared_ptr<Server::Tls> Server::make_tls(ssl::context&& fallback) {
+  auto t{std::make_shared<Tls>(std::move(fallback))};
+  for (auto& make : host_tls) t->hosts.push_back(make());
+  if (!t->hosts.empty()) {
+    SSL_CTX_set_client_hello_cb(t->fallback.native_handle(), select_host,
+                                this);
+    // A connection only gets to a host's context if it asked for the host,
+    // so it's always acknowledged; on the fallback it never is.
+    for (auto& ctx : t->hosts) {
+      SSL_CTX_set_tlsext_servername_callback(ctx.native_handle(), ack_host);
     }
   }
-  return std::filesystem::path(rest);
+  return t;
+}
+
+// Each host's sessions resume only on that host, since its name is its
+// session id context. Reloaded contexts keep the names, so sessions outlive
+// a reload.
+void Server::install(Tls& t) {
+  _resumption.install(t.fallback.native_handle());
+  for (size_t i{}; i < t.hosts.size(); ++i)
+    _resumption.install(t.hosts[i].native_handle(), hostnames[i]);
 }
 
-std::optional<pair<std::reference_wrapper<Handler>, std::filesystem::path>>
-Server::handler_for(const std::filesystem::path& p) {
-  auto it = handlers.lower_bound(p);
-  if (it != handlers.end() && it->first == p)
-    return {{std::ref(it->second), std::filesystem::path{"/"}}};
-  if (it == handlers.begin()) return {};
-  --it;
-  auto pathinfo = relative_path(it->first, p);
-  if (!pathinfo) return {};
-  return {{std::ref(it->second), *pathinfo}};
-}
\ No newline at end of file
+int Server::select_host(SSL* ssl, int*, void* server) {
+  auto name{openssl::client_hello_servername(ssl)};
+  // Without a name we know, the fallback's certificate will do, or the
+  // client will say it won't.
+  if (auto host{static_cast<Server*>(server)->names.find(name)}; host) {
+    // The worker's own, which may be newer than the one the handshake
+    // started with.
+    SSL_set_SSL_CTX(ssl, Worker::current->tls->hosts[*host].native_handle());
+  }
+  return SSL_CLIENT_HELLO_SUCCESS;
+}
+
+// Only on worker 0, like every other change to tls.
+void Server::reload_tls() {
+  if (!options.reload_tls) {
+    return;
+  }
+  try {
+    auto fresh{make_tls(options.reload_tls())};
+    install(*fresh);
+    tls = std::move(fresh);
+  } catch (const std::exception& e) {
+    logging::log(logging::level::error, "Couldn't reload TLS: ", e.what());
+    return;
+  }
+  // Each worker's next handshake uses it; the ones in progress don't.
+  for (auto& w : workers) {
+    asio::post(w->io, [&w = *w, t = tls] { w.tls = t; });
+  }
+  logging::log(logging::level::info, "Reloaded TLS");
+}
+
+void Server::take_listeners() {
+  int conn{handoff::connect(options.handoff)};
+  if (conn < 0) {
+    return;
+  }
+  try {
+    inherited = handoff::receive_fds(conn);
+  } catch (const std::system_error& e) {
+    logging::log(logging::level::warning, "Couldn't take over: ", e.what());
+    ::close(conn);
+    return;
+  }
+  handoff_conn = conn;
+  logging::log(logging::level::info, "Took over ", inherited.size(),
+               " listening sockets");
+  // Closing any we have no worker for would reset what's queued on them,
+  // and the last server keeps them in the SO_REUSEPORT group until it
+  // exits, so they go on getting connections. Workers take them on as
+  // well as their own, and they're handed on with the rest.
+  if (inherited.size() > workers.size()) {
+    logging::log(logging::level::info, "Accepting on ",
+                 inherited.size() - workers.size(),
+                 " more listening sockets than there are workers");
+  }
+}
+
+void Server::write_metrics_file() const {
+  if (options.metrics_file.empty()) return;
+  replace_file(options.metrics_file, _metrics.prometheus());
+}
+
+// The slowest of the interval just gone, if there were any.
+void Server::write_trace_file() {
+  if (!_traces.enabled()) return;
+  auto traces{_traces.take()};
+  if (traces.empty()) return;
+  replace_file(options.tracing.file, SlowTraces::chrome_json(traces));
+}
+
+void Server::shutdown(std::chrono::steady_clock::duration drain) noexcept {
+  if (!is_shutdown.exchange(true)) {
+    logging::log(logging::level::info, "Shutting down");
+  }
+
+  // Each worker tears itself down on its own thread.
+  auto until{TimerWheel::clock::now() + drain};
+  for (auto& w : workers) {
+    asio::post(w->io, [&w = *w, until] { w.shutdown(until); });
+  }
+}
+
+std::optional<Router<Server::Mount>::Match> Server::handler_for(
+    string_view servername, string_view path) const {
+  auto host{names.find(servername)};
+  auto match{routers[host ? *host + 1 : 0].find(path)};
+  CASTOR_PROBE(route, path.data(), path.size(),
+               match ? static_cast<int>(match->value.get().id) : -1);
+  return match;
+}
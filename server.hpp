@@ -2,35 +2,232 @@
 
 class Server;
 
+#include <atomic>
 #include <boost/core/noncopyable.hpp>
+#include <boost/intrusive/list.hpp>
 #include <filesystem>
 #include <functional>
-#include <set>
+#include <list>
 
+#include "admission.hpp"
+#include "bufferpool.hpp"
 #include "client.hpp"
 #include "handler.hpp"
+#include "metrics.hpp"
 #include "net-types.hpp"
+#include "recycler.hpp"
 #include "response.hpp"
+#include "resumption.hpp"
+#include "router.hpp"
+#include "servernames.hpp"
+#include "timerwheel.hpp"
+#include "trace.hpp"
+#include "uring.hpp"
 
 class Server : boost::noncopyable {
  public:
+  struct Options {
+    tcp::endpoint endpoint{tcp::v4(), 1965};
+
+    /// Number of worker threads. Each one runs its own io_context and
+    /// accepts on its own SO_REUSEPORT listening socket, so the kernel
+    /// spreads incoming connections across them.
+    unsigned threads{1};
+
+    /// Pin worker thread n to CPU n (modulo the number of CPUs).
+    bool pin_threads{};
+
+    Resumption::Options resumption{};
+
+    /// Limits on connections and handshakes; see Admission.
+    Admission::Options admission{};
+
+    /// How long each phase of a connection may take. Sending the response
+    /// may take as long as it likes, so long as no write stalls for longer
+    /// than idle_write.
+    struct Timeouts {
+      std::chrono::seconds handshake{5};
+      std::chrono::seconds request{5};
+      std::chrono::seconds first_byte{10};
+      std::chrono::seconds idle_write{10};
+    } timeouts{};
+
+    /// Buffers for responses in flight, shared by every worker.
+    BufferPool::Options buffers{};
+
+    /// Give each worker an io_uring for reading files.
+    FileRing::Options file_ring{};
+
+    /// Serve metrics here, to clients on loopback only; empty for nowhere.
+    std::filesystem::path metrics_route;
+    /// Keep metrics in this file too, for a Prometheus textfile collector,
+    /// rewritten every metrics_interval; empty for no file.
+    std::filesystem::path metrics_file;
+    std::chrono::seconds metrics_interval{15};
+
+    /// Offer every connection's Trace, one in every, to SlowTraces, and
+    /// write the slowest keep of them to file as Chrome trace JSON at the
+    /// end of each interval. No file, no traces.
+    struct Tracing {
+      std::filesystem::path file;
+      unsigned every{100};
+      size_t keep{10};
+      std::chrono::seconds interval{60};
+    } tracing{};
+
+    /// Makes the TLS context again, with whatever certificate is on disk
+    /// now, on SIGHUP, and every VirtualHost's with it. Connections already
+    /// open keep the one they started with. Empty means SIGHUP does nothing.
+    std::function<ssl::context()> reload_tls;
+
+    /// Take the listening sockets over from the server listening on this
+    /// Unix socket, if there is one, then listen on it to hand them on in
+    /// turn; see handoff.hpp. Empty means bind afresh and never hand off.
+    std::filesystem::path handoff;
+
+    /// On SIGTERM or after a handoff, how long open connections get to
+    /// finish before they're cut off. SIGINT or a second SIGTERM doesn't
+    /// wait.
+    std::chrono::seconds drain{30};
+  };
+
+  /// A handler, and the id Metrics counts it under.
+  struct Mount {
+    Handler handler;
+    unsigned id;
+  };
+
+  /// A capsule of its own, picked by the server name the client asks for
+  /// with SNI: its own certificate and its own routes.
+  struct VirtualHost {
+    /// "example.com", or "*.example.com"; see ServerNames.
+    string name;
+    /// Makes its TLS context, at startup and on SIGHUP.
+    std::function<ssl::context()> tls;
+    std::map<std::filesystem::path, Handler> handlers;
+  };
+
+  /// The context and handlers are for clients that ask for none of hosts,
+  /// or for no name at all.
   explicit Server(ssl::context&&,
-                  const std::map<std::filesystem::path, Handler>&);
+                  const std::map<std::filesystem::path, Handler>&,
+                  Options,
+                  const vector<VirtualHost>& hosts = {});
 
   void run();
-  std::optional<pair<std::reference_wrapper<Handler>, std::filesystem::path>>
-  handler_for(const std::filesystem::path& p);
+  /// The handler for path on the virtual host called servername.
+  std::optional<Router<Mount>::Match> handler_for(string_view servername,
+                                                  string_view path) const;
+  Resumption& resumption() { return _resumption; }
+  BufferPool& buffers() { return _buffers; }
+  Admission& admission() { return _admission; }
+  const Metrics& metrics() const { return _metrics; }
+  SlowTraces& traces() { return _traces; }
+  const Options::Tracing& tracing() const { return options.tracing; }
+  const Options::Timeouts& timeouts() const { return options.timeouts; }
 
  private:
-  bool is_shutdown{};
-  io_context io{};
-  std::set<asio::cancellation_signal*> clients{};
-  ssl::context ssl_context;
-  std::map<std::filesystem::path, Handler> handlers;
-  acceptor sock;
-
-  awaitable<void> do_run(const tcp::endpoint);
+  /// The contexts a handshake can use: fallback, which it starts with, and
+  /// a context per virtual host, which the client's SNI switches it to.
+  struct Tls {
+    ssl::context fallback;
+    vector<ssl::context> hosts;
+  };
+
+  /**
+   * Worker is one thread's share of the server. Everything in it is only
+   * touched from its own thread, so nothing on the accept path needs a lock.
+   * The only way in from outside is to post() to io.
+   */
+  struct Worker : boost::noncopyable {
+    Worker(Server&, unsigned id);
+
+    Server& server;
+    const unsigned id;
+    bool is_shutdown{};
+    // Past this, connections still open are cut off.
+    TimerWheel::clock::time_point drain_until;
+    bool finished{};
+    Metrics::Shard& metrics;
+    // New connections get this; reload_tls() replaces it.
+    std::shared_ptr<Tls> tls;
+    // Declared before io, so they outlive any Client its handlers hold.
+    Recycler client_pool;
+    std::optional<FileRing> ring;
+    // Every Client's deadline.
+    TimerWheel wheel;
+    boost::intrusive::list<Client, boost::intrusive::base_hook<client_hook>,
+                           boost::intrusive::constant_time_size<false>>
+        clients;
+    io_context io{1};
+    acceptor sock;
+    // sock's fd, for worker 0 to hand off.
+    std::atomic<int> listen_fd{-1};
+    // Its share of the sockets inherited beyond one per worker.
+    std::list<acceptor> extra_socks;
+    // Worker 0's.
+    std::optional<asio::signal_set> signals;
+    std::optional<local_acceptor> handoff;
+    timer key_timer;
+    timer wheel_timer;
+    timer metrics_timer;
+    timer trace_timer;
+    std::exception_ptr exc{};
+
+    void run();
+    awaitable<void> do_run(const tcp::endpoint);
+    awaitable<void> accept(acceptor&);
+    awaitable<void> rotate_ticket_keys();
+    awaitable<void> tick_timers();
+    awaitable<void> write_metrics();
+    awaitable<void> write_traces();
+    awaitable<void> handle_signals();
+    awaitable<void> serve_handoff();
+    /// Stop accepting, and give the connections open until drain_until.
+    void shutdown(TimerWheel::clock::time_point drain_until) noexcept;
+    /// Cut off whatever's left and stop.
+    void finish() noexcept;
+
+    /// The worker running on this thread, for OpenSSL callbacks.
+    static thread_local Worker* current;
+  };
+
+  Options options;
+  std::atomic<bool> is_shutdown{};
+  // Workers that haven't finished.
+  std::atomic<unsigned> running{};
+  // Each virtual host's, in the same order as tls->hosts.
+  vector<std::function<ssl::context()>> host_tls;
+  vector<string> hostnames;
+  ServerNames names;
+  // Only touched by worker 0 once they're running.
+  std::shared_ptr<Tls> tls;
+  // Listening sockets taken over from the last server, and our connection
+  // to it, until we tell it we've got them.
+  vector<int> inherited;
+  int handoff_conn{-1};
+  std::atomic<bool> handed_off{};
+  Resumption _resumption;
+  BufferPool _buffers;
+  Admission _admission;
+  Metrics _metrics;
+  SlowTraces _traces;
+  // The default host's, then each virtual host's.
+  vector<Router<Mount>> routers;
+  std::vector<std::unique_ptr<Worker>> workers;
+
   void client_finished(std::shared_ptr<Client> client);
-  void on_signal(err ec, int sig);
-  void shutdown() noexcept;
-};
\ No newline at end of file
+  void on_signal(int sig);
+  std::shared_ptr<Tls> make_tls(ssl::context&& fallback);
+  void install(Tls&);
+  void reload_tls();
+  void take_listeners();
+  void write_metrics_file() const;
+  void write_trace_file();
+  void shutdown(std::chrono::steady_clock::duration drain = {}) noexcept;
+
+  // OpenSSL's client hello callback, on the fallback context. It picks the
+  // host before OpenSSL looks for a session to resume, which a servername
+  // callback would be too late for.
+  static int select_host(SSL*, int*, void* server);
+};
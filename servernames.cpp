@@ -0,0 +1,54 @@
+#include "servernames.hpp"
+
+#include <stdexcept>
+
+namespace {
+
+// The longest DNS name, without the root's dot.
+constexpr size_t max_name{253};
+
+char lower(char c) noexcept { return c >= 'A' && c <= 'Z' ? c + 32 : c; }
+
+}  // namespace
+
+ServerNames::ServerNames(std::span<const string> names) {
+  for (size_t i{}; i < names.size(); ++i) {
+    string name{names[i]};
+    std::ranges::transform(name, name.begin(), lower);
+    if (name.ends_with('.')) name.pop_back();
+    auto star{name.find('*')};
+    if (name.empty() || name.size() > max_name ||
+        (star != string::npos &&
+         (!name.starts_with("*.") || name.size() == 2 ||
+          name.find('*', 1) != string::npos)))
+      throw std::invalid_argument{"Bad server name: " + names[i]};
+    if (!index.emplace(std::move(name), i).second)
+      throw std::invalid_argument{"Server name repeated: " + names[i]};
+  }
+}
+
+std::optional<size_t> ServerNames::find(
+    string_view servername) const noexcept {
+  if (servername.ends_with('.')) servername.remove_suffix(1);
+  // A wildcard is only ever ours, never the client's.
+  if (servername.empty() || servername.size() > max_name ||
+      servername.find('*') != string_view::npos)
+    return {};
+
+  // Room for a '*' in place of the first label, which is at least one.
+  array<char, max_name + 1> buf;
+  auto name{buf.data() + 1};
+  std::ranges::transform(servername, name, lower);
+  string_view lowered{name, servername.size()};
+
+  if (auto it{index.find(lowered)}; it != index.end()) return it->second;
+
+  auto dot{lowered.find('.')};
+  if (dot == 0 || dot == string_view::npos) return {};
+  buf[dot] = '*';
+  if (auto it{index.find(string_view{buf.data() + dot, lowered.size() + 1 -
+                                                          dot})};
+      it != index.end())
+    return it->second;
+  return {};
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <optional>
+#include <unordered_map>
+
+#include "types.hpp"
+
+/**
+ * ServerNames finds which virtual host a TLS server name (SNI) is for. Each
+ * host has one name: "example.com", or "*.example.com" for any name with
+ * exactly one more label in front, as in RFC 6125. An exact name wins over
+ * a wildcard. Names are compared without regard to case.
+ *
+ * @par
+ * It's a hash table built once up front, so a lookup is at most two probes
+ * and never allocates. It's read-only once built, so any number of threads
+ * can share it.
+ */
+class ServerNames {
+ public:
+  ServerNames() = default;
+
+  /// Host i is names[i]. Throws invalid_argument on a name that's empty,
+  /// has a wildcard anywhere but the whole first label, or is repeated.
+  explicit ServerNames(std::span<const string> names);
+
+  /// The host for servername, if any.
+  std::optional<size_t> find(string_view servername) const noexcept;
+
+  size_t size() const noexcept { return index.size(); }
+
+ private:
+  struct hash {
+    using is_transparent = void;
+    size_t operator()(string_view s) const noexcept {
+      return std::hash<string_view>{}(s);
+    }
+  };
+
+  std::unordered_map<string, size_t, hash, std::equal_to<>> index;
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include <concepts>
+#include <cstdlib>
+#include <source_location>
+
+#include "types.hpp"
+
+/**
+ * What every test_*.cpp uses: expect(got) == expected prints where and what
+ * didn't match, and exits. Printers for types from namespace std have to be
+ * declared before this is included, or expect() won't find them; printers
+ * for our own types can go anywhere.
+ */
+
+inline std::ostream& operator<<(std::ostream& os, std::source_location loc) {
+  return os << loc.file_name() << ':' << loc.function_name() << ':'
+            << loc.line() << ':' << loc.column();
+}
+
+template <typename T>
+concept Streamable = requires(T t, std::ostream& os) {
+  { os << t } -> std::same_as<std::ostream&>;
+};
+
+template <Streamable T>
+struct expecter {
+  T got;
+  std::source_location loc;
+
+  template <Streamable U>
+  void operator==(U expected) {
+    if (got != expected) {
+      cerr << loc << " Expected: " << expected << " Got: " << got << '\n';
+      std::exit(1);
+    }
+  }
+};
+
+template <Streamable T>
+auto expect(T got, std::source_location loc = std::source_location::current()) {
+  return expecter<T>{got, loc};
+}
+
+/// Give ctx a throwaway self-signed certificate for name, so tests and
+/// benchmarks need no files.
+inline void use_ephemeral_cert(SSL_CTX* ctx,
+                               const char* name = "localhost") {
+  auto key = EVP_EC_gen("P-256");
+  auto cert = X509_new();
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+  X509_set_pubkey(cert, key);
+  auto subject = X509_get_subject_name(cert);
+  X509_NAME_add_entry_by_txt(subject, "CN", MBSTRING_ASC,
+                             reinterpret_cast<const unsigned char*>(name), -1,
+                             -1, 0);
+  X509_set_issuer_name(cert, subject);
+  X509_sign(cert, key, EVP_sha256());
+
+  SSL_CTX_use_certificate(ctx, cert);
+  SSL_CTX_use_PrivateKey(ctx, key);
+  X509_free(cert);
+  EVP_PKEY_free(key);
+}
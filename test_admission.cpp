@@ -0,0 +1,85 @@
+#include "admission.hpp"
+#include "test.hpp"
+
+std::ostream& operator<<(std::ostream& os, Admission::verdict_t v) {
+  return os << static_cast<int>(v);
+}
+
+using verdict_t = Admission::verdict_t;
+auto a1 = boost::asio::ip::make_address("192.0.2.1");
+auto a2 = boost::asio::ip::make_address("192.0.2.2");
+auto a1_mapped = boost::asio::ip::make_address("::ffff:192.0.2.1");
+
+void test_connections() {
+  Admission adm{{.max_connections = 2, .max_per_ip = 0}};
+  {
+    auto t1 = adm.admit(a1);
+    auto t2 = adm.admit(a2);
+    expect(t1.verdict()) == verdict_t::admit;
+    expect(t2.verdict()) == verdict_t::admit;
+    expect(adm.admit(a2).verdict()) == verdict_t::slow_down;
+    expect(adm.connections()) == 2u;
+  }
+  expect(adm.connections()) == 0u;
+  expect(adm.admit(a1).verdict()) == verdict_t::admit;
+  expect(adm.slowed()) == 1u;
+}
+
+void test_per_ip() {
+  Admission adm{{.max_per_ip = 2, .reply_slow_down = false}};
+  auto t1 = adm.admit(a1);
+  auto t2 = adm.admit(a1_mapped);
+  // The same address, whichever way it's written.
+  expect(adm.admit(a1).verdict()) == verdict_t::refuse;
+  expect(adm.admit(a2).verdict()) == verdict_t::admit;
+  {
+    auto moved = std::move(t1);
+  }
+  expect(adm.admit(a1).verdict()) == verdict_t::admit;
+  expect(adm.refused()) == 1u;
+}
+
+void test_handshakes() {
+  Admission adm{{.max_handshakes = 1}};
+  auto t1 = adm.admit(a1);
+  auto t2 = adm.admit(a2);
+  expect(t1.begin_handshake()) == true;
+  expect(t2.begin_handshake()) == false;
+  t1.end_handshake();
+  expect(t2.begin_handshake()) == true;
+  expect(adm.handshakes()) == 1u;
+  {
+    auto t3 = adm.admit(a1);
+  }
+  expect(adm.refused()) == 1u;
+  expect(adm.connections()) == 2u;
+}
+
+void test_slow_downs() {
+  Admission adm{
+      {.max_connections = 1, .max_handshakes = 1, .max_slow_downs = 1}};
+  auto t1 = adm.admit(a1);
+  expect(t1.begin_handshake()) == true;
+  auto t2 = adm.admit(a2);
+  expect(t2.verdict()) == verdict_t::slow_down;
+  // It doesn't wait on the served connections' handshakes, or take one.
+  expect(t2.begin_handshake()) == true;
+  expect(adm.handshakes()) == 1u;
+  // Past the cap, the rest are refused before any TLS.
+  expect(adm.admit(a2).verdict()) == verdict_t::refuse;
+  expect(adm.slowing()) == 1u;
+  {
+    auto moved = std::move(t2);
+  }
+  expect(adm.slowing()) == 0u;
+  expect(adm.admit(a2).verdict()) == verdict_t::slow_down;
+  expect(adm.slowed()) == 2u;
+  expect(adm.refused()) == 1u;
+}
+
+int main() {
+  test_connections();
+  test_per_ip();
+  test_handshakes();
+  test_slow_downs();
+}
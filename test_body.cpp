@@ -0,0 +1,162 @@
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdio>
+
+#include "body.hpp"
+#include "net-types.hpp"
+#include "response.hpp"
+#include "test.hpp"
+
+// The certificate has to be there before a stream is made from the context,
+// since SSL_new() takes a copy.
+ssl::context server_context() {
+  ssl::context ctx{ssl::context::tlsv13_server};
+  use_ephemeral_cert(ctx.native_handle());
+  return ctx;
+}
+
+/**
+ * A TLS connection over a socketpair, handshake done. send(page) runs page
+ * against a fresh Response on the server side, closes it, and returns what
+ * the client read.
+ */
+struct connection {
+  io_context io{1};
+  ssl::context server_ctx{server_context()};
+  ssl::context client_ctx{ssl::context::tlsv13_client};
+  ssl_socket server{io, server_ctx};
+  ssl::stream<tcp::socket> client{io, client_ctx};
+  BufferPool buffers;
+
+  connection() {
+    int fds[2];
+    socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds);
+    // Nothing here cares what kind of socket it is.
+    server.next_layer().assign(tcp::v4(), fds[0]);
+    client.next_layer().assign(tcp::v4(), fds[1]);
+    co_spawn(io, server.async_handshake(ssl::stream_base::server), detached);
+    client.async_handshake(ssl::stream_base::client, [](err) {});
+    io.run();
+    io.restart();
+  }
+
+  template <typename Page>
+  string send(Page page) {
+    Response res{server, buffers};
+    co_spawn(io, page(res), [&](std::exception_ptr e) {
+      if (e) std::rethrow_exception(e);
+      server.next_layer().close();
+    });
+    string got;
+    co_spawn(io, receive(got), detached);
+    io.run();
+    io.restart();
+    return got;
+  }
+
+  // Everything until the server closes.
+  awaitable<void> receive(string& got) {
+    array<char, 4096> buf;
+    for (;;) {
+      err ec;
+      auto n = co_await client.async_read_some(
+          asio::buffer(buf), asio::redirect_error(asio::use_awaitable, ec));
+      got.append(buf.data(), n);
+      if (ec) co_return;
+    }
+  }
+};
+
+constexpr string_view header{"20 text/gemini\r\n"};
+
+void test_span() {
+  connection p;
+  constexpr string_view text{"# Hello\n"};
+  auto got = p.send([&](Response& res) -> awaitable<void> {
+    res.header(Response::code_t::success, "text/gemini");
+    co_await make_body<SpanBody>(res, span{text.data(), text.size()})
+        ->send(res);
+    co_await res.finish();
+  });
+  expect(got) == string{header} + string{text};
+}
+
+// Bigger than a record, so it's buffered and then written around the buffer.
+void test_string() {
+  connection p;
+  string text(3 * Response::record_size + 5, 'x');
+  auto got = p.send([&](Response& res) -> awaitable<void> {
+    res.header(Response::code_t::success, "text/gemini");
+    co_await make_body<StringBody>(res, text)->send(res);
+    co_await res.finish();
+  });
+  expect(got.size()) == header.size() + text.size();
+  expect(got) == string{header} + text;
+}
+
+// A file of n bytes, each its offset's low byte.
+std::FILE* make_file(size_t n) {
+  auto f{std::tmpfile()};
+  for (size_t i{}; i < n; ++i) std::fputc(static_cast<char>(i), f);
+  std::fflush(f);
+  return f;
+}
+
+void test_file() {
+  connection p;
+  size_t size{3 * Response::record_size + 5};
+  auto f{make_file(size)};
+  auto got = p.send([&](Response& res) -> awaitable<void> {
+    res.header(Response::code_t::success, "text/gemini");
+    co_await make_body<FileBody>(res, dup(fileno(f)))->send(res);
+    co_await res.finish();
+  });
+  expect(got.size()) == header.size() + size;
+  expect(got.starts_with(header)) == true;
+  for (size_t i{}; i < size; ++i)
+    if (got[header.size() + i] != static_cast<char>(i)) {
+      expect(i) == size;
+    }
+  std::fclose(f);
+}
+
+// A file that gets shorter while it's sent comes out short, not as an error
+// and not padded out to the size it had.
+void test_file_shrinks() {
+  connection p;
+  size_t size{8 * Response::record_size};
+  auto f{make_file(size)};
+  Response res{p.server, p.buffers};
+  bool done{};
+  co_spawn(p.io, [&]() -> awaitable<void> {
+    res.header(Response::code_t::success, "text/gemini");
+    co_await make_body<FileBody>(res, dup(fileno(f)))->send(res);
+    co_await res.finish();
+    done = true;
+    p.server.next_layer().close();
+  }, [](std::exception_ptr e) { if (e) std::rethrow_exception(e); });
+  string got;
+  co_spawn(p.io, p.receive(got), detached);
+  // Once the first record's out, the rest of the file goes.
+  while (res.bytes_sent() == 0) p.io.run_one();
+  expect(ftruncate(fileno(f), 0)) == 0;
+  p.io.run();
+
+  expect(done) == true;
+  expect(got.starts_with(header)) == true;
+  expect(got.size() > header.size()) == true;
+  expect(got.size() < header.size() + size) == true;
+  for (size_t i{}; i < got.size() - header.size(); ++i)
+    if (got[header.size() + i] != static_cast<char>(i)) {
+      expect(i) == got.size() - header.size();
+    }
+  std::fclose(f);
+}
+
+int main() {
+  test_span();
+  test_string();
+  test_file();
+  test_file_shrinks();
+}
@@ -0,0 +1,72 @@
+#include "bufferpool.hpp"
+#include "test.hpp"
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+namespace asio = boost::asio;
+
+void test_classes() {
+  BufferPool pool;
+  expect(pool.try_get(1).size()) == 4096u;
+  expect(pool.try_get(4097).size()) == 16384u;
+  expect(pool.try_get(16384).size()) == 16384u;
+  // Nothing bigger than the largest class.
+  expect(pool.try_get(1 << 20).size()) == 65536u;
+  expect(pool.in_use()) == 0u;
+}
+
+void test_reuse() {
+  BufferPool pool;
+  char* p;
+  {
+    auto b = pool.try_get(100);
+    p = b.data();
+    expect(pool.in_use()) == 4096u;
+  }
+  expect(pool.try_get(100).data() == p) == true;
+  // Another class doesn't get it.
+  expect(pool.try_get(10000).data() == p) == false;
+}
+
+void test_cap() {
+  BufferPool pool{{.cap = 2 * 16384}};
+  auto a = pool.try_get(16384);
+  auto b = pool.try_get(16384);
+  expect(static_cast<bool>(pool.try_get(1))) == false;
+  expect(pool.in_use()) == 2 * 16384u;
+  expect(pool.peak()) == 2 * 16384u;
+  a = {};
+  expect(static_cast<bool>(pool.try_get(1))) == true;
+  expect(pool.peak()) == 2 * 16384u;
+}
+
+void test_wait() {
+  BufferPool pool{{.cap = 16384}};
+  asio::io_context io;
+  auto held = pool.try_get(16384);
+  bool got{};
+
+  asio::co_spawn(
+      io,
+      [&]() -> asio::awaitable<void> {
+        auto b = co_await pool.get(16384);
+        got = static_cast<bool>(b);
+      },
+      asio::detached);
+  // Give the buffer back only once the coroutine's waiting.
+  asio::post(io, [&] { held = {}; });
+  io.run();
+
+  expect(got) == true;
+  expect(pool.waits()) == 1u;
+  expect(pool.in_use()) == 0u;
+}
+
+int main() {
+  test_classes();
+  test_reuse();
+  test_cap();
+  test_wait();
+}
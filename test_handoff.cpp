@@ -0,0 +1,88 @@
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "handoff.hpp"
+#include "test.hpp"
+
+// A socket listening on an ephemeral loopback port.
+int listener() {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{.sin_family = AF_INET,
+                   .sin_addr = {.s_addr = htonl(INADDR_LOOPBACK)}};
+  bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr);
+  listen(fd, 8);
+  return fd;
+}
+
+uint16_t port_of(int fd) {
+  sockaddr_in addr{};
+  socklen_t len{sizeof addr};
+  getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len);
+  return ntohs(addr.sin_port);
+}
+
+bool same_socket(int a, int b) {
+  struct stat sa, sb;
+  fstat(a, &sa);
+  fstat(b, &sb);
+  return sa.st_ino == sb.st_ino;
+}
+
+void test_round_trip() {
+  int pair[2];
+  socketpair(AF_UNIX, SOCK_STREAM, 0, pair);
+  array<int, 3> sent{listener(), listener(), listener()};
+  handoff::send_fds(pair[0], sent);
+  auto got = handoff::receive_fds(pair[1]);
+
+  expect(got.size()) == sent.size();
+  for (size_t i = 0; i < sent.size(); ++i) {
+    // New descriptors, for the very same listening sockets, in order.
+    expect(got[i] != sent[i]) == true;
+    expect(same_socket(got[i], sent[i])) == true;
+    expect(port_of(got[i])) == port_of(sent[i]);
+    expect(fcntl(got[i], F_GETFD) & FD_CLOEXEC) == FD_CLOEXEC;
+  }
+  // The sender's copies can go; the receiver's still listen.
+  for (auto fd : sent) close(fd);
+  int c = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{.sin_family = AF_INET,
+                   .sin_port = htons(port_of(got[0])),
+                   .sin_addr = {.s_addr = htonl(INADDR_LOOPBACK)}};
+  expect(connect(c, reinterpret_cast<sockaddr*>(&addr), sizeof addr)) == 0;
+  int accepted = accept(got[0], nullptr, nullptr);
+  expect(accepted >= 0) == true;
+  for (auto fd : {c, accepted, got[0], got[1], got[2], pair[0], pair[1]})
+    close(fd);
+}
+
+void test_nothing_to_send() {
+  int pair[2];
+  socketpair(AF_UNIX, SOCK_STREAM, 0, pair);
+  handoff::send_fds(pair[0], {});
+  expect(handoff::receive_fds(pair[1]).size()) == 0u;
+
+  // The other end went away without sending anything.
+  close(pair[0]);
+  bool threw{};
+  try {
+    handoff::receive_fds(pair[1]);
+  } catch (const std::system_error&) {
+    threw = true;
+  }
+  expect(threw) == true;
+  close(pair[1]);
+}
+
+void test_nobody_listening() {
+  expect(handoff::connect("/nonexistent/castor.sock")) == -1;
+}
+
+int main() {
+  test_round_trip();
+  test_nothing_to_send();
+  test_nobody_listening();
+}
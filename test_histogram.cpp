@@ -0,0 +1,51 @@
+#include "histogram.hpp"
+#include "test.hpp"
+
+void test_buckets() {
+  using H = Histogram<5>;
+  // Buckets tile the whole range with no gaps or overlaps.
+  for (size_t i = 1; i < H::bucket_count; ++i) {
+    expect(H::lower_bound(i)) == H::upper_bound(i - 1) + 1;
+  }
+  expect(H::upper_bound(H::bucket_count - 1)) == ~uint64_t{};
+
+  for (uint64_t v : {0ul, 1ul, 31ul, 32ul, 33ul, 1000ul, 123456789ul,
+                     ~uint64_t{}}) {
+    auto i = H::index(v);
+    expect(H::lower_bound(i) <= v) == true;
+    expect(v <= H::upper_bound(i)) == true;
+  }
+
+  // Values are kept to within 1/32 of themselves.
+  auto i = H::index(1'000'000);
+  expect((H::upper_bound(i) - H::lower_bound(i)) * 32 <= 1'000'000) == true;
+}
+
+void test_quantiles() {
+  Histogram<> h;
+  expect(h.quantile(0.5)) == 0u;
+
+  for (uint64_t v = 1; v <= 1000; ++v) h.record(v);
+  expect(h.count()) == 1000u;
+  expect(h.sum()) == 500500u;
+  expect(h.max()) == 1000u;
+
+  auto near = [](uint64_t got, uint64_t want) {
+    return got >= want && got <= want + want / 32;
+  };
+  expect(near(h.quantile(0.5), 500)) == true;
+  expect(near(h.quantile(0.99), 990)) == true;
+  expect(h.quantile(1)) == 1000u;
+
+  Histogram<> h2;
+  h2.record(5000, 1000);
+  h2 += h;
+  expect(h2.count()) == 2000u;
+  expect(near(h2.quantile(0.25), 500)) == true;
+  expect(near(h2.quantile(0.75), 5000)) == true;
+}
+
+int main() {
+  test_buckets();
+  test_quantiles();
+}
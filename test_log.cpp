@@ -0,0 +1,80 @@
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "log.hpp"
+#include "test.hpp"
+
+/// Everything logged while f runs, as the Writer wrote it.
+template <typename F>
+vector<string> capture(logging::level threshold, F f) {
+  auto file{std::tmpfile()};
+  {
+    logging::Writer w{fileno(file), threshold};
+    f();
+  }
+  std::rewind(file);
+  vector<string> lines;
+  array<char, 1024> line;
+  while (std::fgets(line.data(), line.size(), file)) lines.push_back(line.data());
+  std::fclose(file);
+  return lines;
+}
+
+void test_format() {
+  logging::endpoint peer{boost::asio::ip::make_address("192.0.2.1"), 41234};
+  logging::endpoint peer6{boost::asio::ip::make_address("2001:db8::1"), 1965};
+
+  auto lines = capture(logging::level::info, [&] {
+    logging::log(logging::level::debug, "filtered out");
+    logging::log(logging::level::info, "Listening on port ", 1965);
+    logging::log(logging::level::warning, peer6, "Error: ", 'x');
+    logging::access(peer, 20, std::chrono::microseconds{1234}, "/asdf/",
+                    ' ', "text/gemini");
+  });
+
+  expect(lines.size()) == 3u;
+  // 2022-07-04T12:00:00.000Z is 24 chars; skip it.
+  expect(lines[0].substr(24)) == " INFO Listening on port 1965\n";
+  expect(lines[1].substr(24)) == " WARNING [2001:db8::1]:1965 Error: x\n";
+  expect(lines[2].substr(24)) ==
+      " 192.0.2.1:41234 20 1234us /asdf/ text/gemini\n";
+  expect(lines[2][10]) == 'T';
+  expect(lines[2][23]) == 'Z';
+}
+
+void test_truncation() {
+  string huge(1000, 'a');
+  auto lines = capture(logging::level::debug,
+                       [&] { logging::log(logging::level::error, huge); });
+  expect(lines.size()) == 1u;
+  expect(lines[0].length()) ==
+      24 + " ERROR "s.length() + sizeof logging::Record::text + 1;
+}
+
+void test_threads() {
+  constexpr int threads = 4, each = 500;
+  auto lines = capture(logging::level::debug, [] {
+    vector<std::jthread> ts;
+    for (int t = 0; t < threads; ++t) {
+      ts.emplace_back([t] {
+        for (int i = 0; i < each; ++i)
+          logging::log(logging::level::debug, "thread ", t, " record ", i);
+      });
+    }
+  });
+  expect(lines.size()) == static_cast<size_t>(threads * each);
+  // Each thread's records come out in order.
+  array<int, threads> next{};
+  for (auto& l : lines) {
+    int t, i;
+    std::sscanf(l.c_str() + 24, " DEBUG thread %d record %d", &t, &i);
+    expect(i) == next[t]++;
+  }
+}
+
+int main() {
+  test_format();
+  test_truncation();
+  test_threads();
+}
@@ -0,0 +1,65 @@
+#include "lru.hpp"
+#include "test.hpp"
+
+void test_eviction() {
+  Lru<int> lru{2};
+  lru.insert("a", 1);
+  lru.insert("b", 2);
+  expect(*lru.find("a")) == 1;
+  lru.insert("c", 3);
+  // b was least recently used.
+  expect(lru.find("b") == nullptr) == true;
+  expect(*lru.find("a")) == 1;
+  expect(*lru.find("c")) == 3;
+  expect(lru.size()) == 2u;
+}
+
+void test_replace_and_erase() {
+  Lru<int> lru{2};
+  lru.insert("a", 1);
+  lru.insert("a", 10);
+  expect(lru.size()) == 1u;
+  expect(*lru.find("a")) == 10;
+  lru.erase("a");
+  lru.erase("nothing");
+  expect(lru.find("a") == nullptr) == true;
+  expect(lru.size()) == 0u;
+}
+
+void test_cost() {
+  Lru<string> lru{10};
+  lru.insert("a", "aaaa", 4);
+  lru.insert("b", "bbbb", 4);
+  expect(lru.cost()) == 8u;
+  lru.insert("c", "cccc", 4);
+  expect(lru.find("a") == nullptr) == true;
+  expect(lru.cost()) == 8u;
+  // Too big for the whole thing, so nothing's left.
+  lru.insert("d", "dddd", 11);
+  expect(lru.size()) == 0u;
+  expect(lru.cost()) == 0u;
+}
+
+void test_sharded() {
+  ShardedLru<std::shared_ptr<int>, 4> lru{4};
+  expect(decltype(lru)::shard_capacity(4)) == 1u;
+  expect(decltype(lru)::shard_capacity(2)) == 1u;
+  for (int i = 0; i < 100; ++i)
+    lru.insert(std::to_string(i), std::make_shared<int>(i));
+  // A value per shard, at most.
+  expect(lru.size() <= 4u) == true;
+  expect(lru.size() > 0u) == true;
+  // The last one in is always there.
+  expect(**lru.find("99")) == 99;
+  lru.erase("99");
+  expect(lru.find("99").has_value()) == false;
+  lru.clear();
+  expect(lru.size()) == 0u;
+}
+
+int main() {
+  test_eviction();
+  test_replace_and_erase();
+  test_cost();
+  test_sharded();
+}
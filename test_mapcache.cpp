@@ -0,0 +1,69 @@
+#include <unistd.h>
+
+#include <fstream>
+
+#include "handler/mapcache.hpp"
+#include "test.hpp"
+
+namespace fs = std::filesystem;
+
+void put(const fs::path& p, string_view contents) {
+  std::ofstream{p, std::ios::binary} << contents;
+}
+
+string_view view(const MapCache::mapping_ptr& m) {
+  return {m->bytes().data(), m->bytes().size()};
+}
+
+void test_sharing(const fs::path& dir) {
+  MapCache maps;
+  put(dir / "a.gmi", "# A\n");
+  auto first = maps.map(dir / "a.gmi");
+  expect(view(first)) == "# A\n"sv;
+  // Same file, same mapping, even by another spelling of the path.
+  expect(maps.map(dir / "." / "a.gmi") == first) == true;
+  expect(maps.size()) == 1u;
+
+  // Replacing the file maps the new one; the old mapping stays readable.
+  put(dir / "b.tmp", "# A, take two\n");
+  fs::rename(dir / "b.tmp", dir / "a.gmi");
+  auto second = maps.map(dir / "a.gmi");
+  expect(second == first) == false;
+  expect(view(second)) == "# A, take two\n"sv;
+  expect(view(first)) == "# A\n"sv;
+  expect(maps.size()) == 1u;
+}
+
+void test_misses(const fs::path& dir) {
+  MapCache maps;
+  expect(maps.map(dir / "nope") == nullptr) == true;
+  expect(maps.map(dir) == nullptr) == true;
+  put(dir / "empty", "");
+  auto empty = maps.map(dir / "empty");
+  expect(empty != nullptr) == true;
+  expect(empty->size) == 0u;
+}
+
+void test_eviction(const fs::path& dir) {
+  MapCache maps{2};
+  put(dir / "1", "one");
+  put(dir / "2", "two");
+  put(dir / "3", "three");
+  auto one = maps.map(dir / "1");
+  maps.map(dir / "2");
+  maps.map(dir / "1");
+  maps.map(dir / "3");
+  expect(maps.size()) == 2u;
+  // 2 was least recently used, so 1 is still the same mapping.
+  expect(maps.map(dir / "1") == one) == true;
+}
+
+int main() {
+  auto dir = fs::temp_directory_path() /
+             ("test_mapcache." + std::to_string(getpid()));
+  fs::create_directory(dir);
+  test_sharing(dir);
+  test_misses(dir);
+  test_eviction(dir);
+  fs::remove_all(dir);
+}
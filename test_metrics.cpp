@@ -0,0 +1,122 @@
+#include <thread>
+
+#include "metrics.hpp"
+#include "test.hpp"
+
+bool has_line(const string& text, string_view line) {
+  return text.find("\n" + string{line} + "\n") != string::npos;
+}
+
+void test_shards_add_up() {
+  Metrics m{{"/a", "/b"}};
+  auto& s1 = m.add_shard();
+  auto& s2 = m.add_shard();
+
+  // Each shard has its own writer.
+  std::jthread t1{[&] {
+    Metrics::bind(s1);
+    auto& s = *Metrics::local();
+    for (int i = 0; i < 1000; ++i) {
+      s.accepted.add();
+      s.responses[20].add();
+      s.bytes_sent.add(100);
+    }
+    s.closed.add(999);
+  }};
+  std::jthread t2{[&] {
+    Metrics::bind(s2);
+    auto& s = *Metrics::local();
+    for (int i = 0; i < 500; ++i) {
+      s.accepted.add();
+      s.responses[51].add();
+    }
+    s.closed.add(500);
+    s.handshake_failures.add(3);
+  }};
+  t1.join();
+  t2.join();
+  expect(Metrics::local() == nullptr) == true;
+
+  auto text = m.prometheus();
+  expect(has_line(text, "castor_connections_accepted_total 1500")) == true;
+  expect(has_line(text, "castor_connections_active 1")) == true;
+  expect(has_line(text, "castor_handshake_failures_total 3")) == true;
+  expect(has_line(text, "castor_bytes_sent_total 100000")) == true;
+  expect(has_line(text, "castor_responses_total{code=\"20\"} 1000")) == true;
+  expect(has_line(text, "castor_responses_total{code=\"51\"} 500")) == true;
+  expect(text.find("code=\"59\"") == string::npos) == true;
+}
+
+void test_latency() {
+  Metrics m{{"/a", "/b\"c"}};
+  auto& s1 = m.add_shard();
+  auto& s2 = m.add_shard();
+  s1.handler_latency[0].record(0);
+  s1.handler_latency[0].record(3);
+  s2.handler_latency[0].record(1000);
+  s2.handler_latency[0].record(uint64_t{1} << 40);
+
+  auto text = m.prometheus();
+  // Under 1 µs, then under 4 µs, and so on; each counts all the ones below.
+  expect(has_line(text, "castor_handler_seconds_bucket{mount=\"/a\","
+                        "le=\"1e-06\"} 1")) == true;
+  expect(has_line(text, "castor_handler_seconds_bucket{mount=\"/a\","
+                        "le=\"4e-06\"} 2")) == true;
+  expect(has_line(text, "castor_handler_seconds_bucket{mount=\"/a\","
+                        "le=\"0.001024\"} 3")) == true;
+  expect(has_line(text, "castor_handler_seconds_bucket{mount=\"/a\","
+                        "le=\"+Inf\"} 4")) == true;
+  expect(has_line(text, "castor_handler_seconds_count{mount=\"/a\"} 4")) ==
+      true;
+  // Quotes in a mount point are escaped, and empty mounts still show up.
+  expect(has_line(text, "castor_handler_seconds_count{mount=\"/b\\\"c\"} 0")) ==
+      true;
+}
+
+void test_phases() {
+  Metrics m{{}};
+  auto& s = m.add_shard();
+  Trace t;
+  t.mark(phase_t::accept);
+  t.mark(phase_t::request);
+  t.end();
+  // Only the phases that ran count.
+  s.record(t);
+  expect(s.phase_latency[static_cast<size_t>(phase_t::accept)].count()) == 1u;
+  expect(s.phase_latency[static_cast<size_t>(phase_t::request)].count()) ==
+      1u;
+  expect(s.phase_latency[static_cast<size_t>(phase_t::route)].count()) == 0u;
+
+  auto text = m.prometheus();
+  expect(has_line(text, "castor_phase_seconds_count{phase=\"handshake\"} 1")) ==
+      true;
+  expect(has_line(text, "castor_phase_seconds_count{phase=\"handler\"} 0")) ==
+      true;
+}
+
+void test_readings() {
+  Metrics m{{}};
+  uint64_t in_use{4096}, waits{};
+  m.add_gauge("castor_buffer_bytes_in_use", "Bytes.", [&] { return in_use; });
+  m.add_counter("castor_buffer_waits_total", "Waits.", [&] { return waits; });
+
+  auto text = m.prometheus();
+  expect(has_line(text, "# TYPE castor_buffer_bytes_in_use gauge")) == true;
+  expect(has_line(text, "castor_buffer_bytes_in_use 4096")) == true;
+  expect(has_line(text, "# TYPE castor_buffer_waits_total counter")) == true;
+  expect(has_line(text, "castor_buffer_waits_total 0")) == true;
+
+  // Read each time, not when they were added.
+  in_use = 0;
+  waits = 7;
+  text = m.prometheus();
+  expect(has_line(text, "castor_buffer_bytes_in_use 0")) == true;
+  expect(has_line(text, "castor_buffer_waits_total 7")) == true;
+}
+
+int main() {
+  test_shards_add_up();
+  test_latency();
+  test_phases();
+  test_readings();
+}
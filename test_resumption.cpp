@@ -0,0 +1,177 @@
+#include <stdexcept>
+
+#include "openssl.hpp"
+#include "resumption.hpp"
+#include "test.hpp"
+
+/**
+ * connect(server, client, session) does a handshake between the two contexts
+ * over an in-memory BIO pair, offering session if it isn't null, and asking
+ * for servername if there is one. It returns whether the handshake resumed
+ * and leaves the client's new session, if any, in session.
+ */
+bool connect(SSL_CTX* server_ctx, SSL_CTX* client_ctx, SSL_SESSION*& session,
+             Resumption& r, const char* servername = nullptr) {
+  auto server{SSL_new(server_ctx)};
+  auto client{SSL_new(client_ctx)};
+  if (servername) SSL_set_tlsext_host_name(client, servername);
+  BIO *sbio, *cbio;
+  BIO_new_bio_pair(&sbio, 0, &cbio, 0);
+  SSL_set_bio(server, sbio, sbio);
+  SSL_set_bio(client, cbio, cbio);
+  SSL_set_accept_state(server);
+  SSL_set_connect_state(client);
+  if (session) SSL_set_session(client, session);
+
+  for (int i = 0; i < 10; ++i) {
+    SSL_do_handshake(client);
+    SSL_do_handshake(server);
+  }
+  expect(SSL_is_init_finished(server)) == 1;
+  r.handshake_done(server);
+
+  // TLS 1.3 tickets come after the handshake; a round of data delivers them.
+  char c{'x'};
+  SSL_write(server, &c, 1);
+  SSL_read(client, &c, 1);
+
+  bool resumed = SSL_session_reused(server);
+  if (session) SSL_SESSION_free(session);
+  session = SSL_get1_session(client);
+  // Without a clean shutdown, OpenSSL won't resume the session.
+  SSL_shutdown(client);
+  SSL_shutdown(server);
+  SSL_free(client);
+  SSL_free(server);
+  return resumed;
+}
+
+void test_mode(Resumption::mode_t mode) {
+  auto server_ctx{SSL_CTX_new(TLS_server_method())};
+  auto client_ctx{SSL_CTX_new(TLS_client_method())};
+  use_ephemeral_cert(server_ctx);
+  Resumption r{server_ctx, {.mode = mode}};
+
+  SSL_SESSION* session{};
+  expect(connect(server_ctx, client_ctx, session, r)) == false;
+  bool on = mode != Resumption::mode_t::off;
+  expect(connect(server_ctx, client_ctx, session, r)) == on;
+
+  if (mode == Resumption::mode_t::tickets) {
+    // A ticket under the previous key still works, and gets replaced...
+    r.rotate_keys();
+    expect(connect(server_ctx, client_ctx, session, r)) == true;
+    // ...but one from two keys ago doesn't.
+    r.rotate_keys();
+    r.rotate_keys();
+    expect(connect(server_ctx, client_ctx, session, r)) == false;
+    expect(r.resumed()) == 2u;
+    expect(r.full()) == 2u;
+  } else {
+    expect(r.resumed()) == (on ? 1u : 0u);
+    expect(r.full()) == (on ? 1u : 2u);
+  }
+  SSL_SESSION_free(session);
+  SSL_CTX_free(client_ctx);
+  SSL_CTX_free(server_ctx);
+}
+
+void test_cache_eviction() {
+  auto server_ctx{SSL_CTX_new(TLS_server_method())};
+  auto client_ctx{SSL_CTX_new(TLS_client_method())};
+  use_ephemeral_cert(server_ctx);
+  // One session per shard, so enough new ones push out the first.
+  Resumption r{server_ctx,
+               {.mode = Resumption::mode_t::cache, .cache_size = 1}};
+
+  SSL_SESSION* first{};
+  connect(server_ctx, client_ctx, first, r);
+  for (int i = 0; i < 256; ++i) {
+    SSL_SESSION* other{};
+    connect(server_ctx, client_ctx, other, r);
+    SSL_SESSION_free(other);
+  }
+  expect(connect(server_ctx, client_ctx, first, r)) == false;
+  SSL_SESSION_free(first);
+  SSL_CTX_free(client_ctx);
+  SSL_CTX_free(server_ctx);
+}
+
+// Clients resume across a certificate reload, on the context that replaced
+// the one they first connected to.
+void test_install(Resumption::mode_t mode) {
+  auto old_ctx{SSL_CTX_new(TLS_server_method())};
+  auto new_ctx{SSL_CTX_new(TLS_server_method())};
+  auto client_ctx{SSL_CTX_new(TLS_client_method())};
+  use_ephemeral_cert(old_ctx);
+  use_ephemeral_cert(new_ctx);
+  Resumption r{old_ctx, {.mode = mode}};
+  r.install(new_ctx);
+
+  SSL_SESSION* session{};
+  expect(connect(old_ctx, client_ctx, session, r)) == false;
+  expect(connect(new_ctx, client_ctx, session, r)) == true;
+  SSL_SESSION_free(session);
+  SSL_CTX_free(client_ctx);
+  SSL_CTX_free(new_ctx);
+  SSL_CTX_free(old_ctx);
+}
+
+// Switches to the context for the name asked for, as Server does.
+int select_host(SSL* ssl, int*, void* hosts) {
+  auto name{openssl::client_hello_servername(ssl)};
+  if (!name.empty())
+    SSL_set_SSL_CTX(ssl, static_cast<SSL_CTX**>(hosts)[name == "b.test"]);
+  return SSL_CLIENT_HELLO_SUCCESS;
+}
+
+// A session from one virtual host doesn't resume on another, even though
+// they share a Resumption and a ticket key.
+void test_hosts(Resumption::mode_t mode) {
+  auto fallback{SSL_CTX_new(TLS_server_method())};
+  SSL_CTX* hosts[]{SSL_CTX_new(TLS_server_method()),
+                   SSL_CTX_new(TLS_server_method())};
+  auto client_ctx{SSL_CTX_new(TLS_client_method())};
+  use_ephemeral_cert(fallback);
+  use_ephemeral_cert(hosts[0], "a.test");
+  use_ephemeral_cert(hosts[1], "b.test");
+  Resumption r{fallback, {.mode = mode}};
+  r.install(hosts[0], "a.test");
+  r.install(hosts[1], "b.test");
+  SSL_CTX_set_client_hello_cb(fallback, select_host, hosts);
+
+  SSL_SESSION* session{};
+  expect(connect(fallback, client_ctx, session, r, "a.test")) == false;
+  expect(connect(fallback, client_ctx, session, r, "a.test")) == true;
+  expect(connect(fallback, client_ctx, session, r, "b.test")) == false;
+  expect(connect(fallback, client_ctx, session, r, "a.test")) == false;
+  expect(connect(fallback, client_ctx, session, r, "a.test")) == true;
+  SSL_SESSION_free(session);
+  SSL_CTX_free(client_ctx);
+  for (auto h : hosts) SSL_CTX_free(h);
+  SSL_CTX_free(fallback);
+}
+
+void test_lifetime() {
+  auto ctx{SSL_CTX_new(TLS_server_method())};
+  bool threw{};
+  try {
+    Resumption r{ctx, {.lifetime = std::chrono::seconds{0}}};
+  } catch (const std::invalid_argument&) {
+    threw = true;
+  }
+  expect(threw) == true;
+  SSL_CTX_free(ctx);
+}
+
+int main() {
+  test_mode(Resumption::mode_t::off);
+  test_mode(Resumption::mode_t::cache);
+  test_mode(Resumption::mode_t::tickets);
+  test_cache_eviction();
+  test_install(Resumption::mode_t::cache);
+  test_install(Resumption::mode_t::tickets);
+  test_hosts(Resumption::mode_t::cache);
+  test_hosts(Resumption::mode_t::tickets);
+  test_lifetime();
+}
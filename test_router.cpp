@@ -0,0 +1,60 @@
+#include <source_location>
+
+#include "router.hpp"
+#include "test.hpp"
+
+void test_router() {
+  Router<string> r{std::map<std::filesystem::path, string>{
+      {"/a", "a"},
+      {"/a/b/c", "abc"},
+      {"/x/y/", "xy"},
+      {"/x/y/z/w", "xyzw"},
+      {"/xy", "xy2"},
+  }};
+
+  auto test_one = [&](string_view path, string_view value, string_view info,
+                      std::source_location loc =
+                          std::source_location::current()) {
+    auto m = r.find(path);
+    expect(m.has_value(), loc) == !value.empty();
+    if (!m) return;
+    expect(string_view{m->value.get()}, loc) == value;
+    expect(m->path_info, loc) == info;
+  };
+
+  test_one("/a", "a", "/");
+  test_one("/a/", "a", "/");
+  test_one("/a/b", "a", "/b");
+  test_one("/a/b/c", "abc", "/");
+  test_one("/a/b/c/d/e", "abc", "/d/e");
+  test_one("/a/b/cd", "a", "/b/cd");
+  test_one("/ab", "", "");
+  test_one("/x", "", "");
+  test_one("/x/y/z", "xy", "/z");
+  test_one("/x/y/z/w/v", "xyzw", "/v");
+  test_one("/xy/z", "xy2", "/z");
+  test_one("/", "", "");
+  test_one("relative", "", "");
+}
+
+void test_root_mount() {
+  Router<int> r{std::map<std::filesystem::path, int>{{"/", 1}, {"/a", 2}}};
+
+  auto m = r.find("/");
+  expect(m.has_value()) == true;
+  expect(m->value.get()) == 1;
+  expect(m->path_info) == "/";
+
+  m = r.find("/b/c");
+  expect(m->value.get()) == 1;
+  expect(m->path_info) == "/b/c";
+
+  m = r.find("/a/c");
+  expect(m->value.get()) == 2;
+  expect(m->path_info) == "/c";
+}
+
+int main() {
+  test_router();
+  test_root_mount();
+}
@@ -0,0 +1,77 @@
+#include <stdexcept>
+
+#include "servernames.hpp"
+
+std::ostream& operator<<(std::ostream& os, std::optional<size_t> i) {
+  if (i) return os << *i;
+  return os << "nothing";
+}
+
+#include "test.hpp"
+
+const vector<string> names{"example.com", "*.example.com",
+                           "capsule.example.com", "Other.Net."};
+const ServerNames hosts{names};
+constexpr std::optional<size_t> none;
+
+void test_exact() {
+  expect(hosts.size()) == 4u;
+  expect(hosts.find("example.com")) == 0u;
+  expect(hosts.find("capsule.example.com")) == 2u;
+  expect(hosts.find("other.net")) == 3u;
+  expect(hosts.find("example.org")) == none;
+  expect(hosts.find("")) == none;
+}
+
+void test_case_and_dot() {
+  expect(hosts.find("EXAMPLE.com")) == 0u;
+  expect(hosts.find("example.com.")) == 0u;
+  expect(hosts.find("OTHER.net.")) == 3u;
+  expect(hosts.find(".")) == none;
+}
+
+void test_wildcard() {
+  expect(hosts.find("a.example.com")) == 1u;
+  expect(hosts.find("Blog.Example.Com")) == 1u;
+  // An exact name wins.
+  expect(hosts.find("capsule.example.com")) == 2u;
+  // Exactly one label.
+  expect(hosts.find("a.b.example.com")) == none;
+  expect(hosts.find(".example.com")) == none;
+  expect(hosts.find("www.other.net")) == none;
+  // Only our names have wildcards.
+  expect(hosts.find("*.example.com")) == none;
+}
+
+void test_long() {
+  string label(63, 'a');
+  string name{label + '.' + label + '.' + label + '.' + label.substr(2)};
+  expect(name.size()) == 253u;
+  vector<string> long_names{"*" + name.substr(63)};
+  ServerNames h{long_names};
+  expect(h.find(name)) == 0u;
+  expect(h.find(name + '.')) == 0u;
+  expect(h.find('a' + name)) == none;
+}
+
+void test_bad_names() {
+  for (vector<string> bad : {vector<string>{""}, {"a.*.com"}, {"*"},
+                             {"*."}, {"w*.example.com"}, {"*.*.com"},
+                             {"example.com", "EXAMPLE.COM."}}) {
+    bool threw{};
+    try {
+      ServerNames{bad};
+    } catch (const std::invalid_argument&) {
+      threw = true;
+    }
+    expect(threw) == true;
+  }
+}
+
+int main() {
+  test_exact();
+  test_case_and_dot();
+  test_wildcard();
+  test_long();
+  test_bad_names();
+}
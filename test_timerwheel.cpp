@@ -0,0 +1,135 @@
+#include <random>
+#include "test.hpp"
+#include "timerwheel.hpp"
+
+using namespace std::chrono;
+const auto t0 = TimerWheel::clock::time_point{};
+
+void test_expiry() {
+  TimerWheel wheel{100ms, t0};
+  int fired{};
+  TimerWheel::Timer t{wheel, [&] { ++fired; }};
+  t.arm(250ms);
+  wheel.advance(t0 + 200ms);
+  expect(fired) == 0;
+  expect(t.armed()) == true;
+  // Rounded up to the next tick.
+  wheel.advance(t0 + 300ms);
+  expect(fired) == 1;
+  expect(t.armed()) == false;
+  wheel.advance(t0 + 10s);
+  expect(fired) == 1;
+}
+
+void test_rearm_and_cancel() {
+  TimerWheel wheel{100ms, t0};
+  int fired{};
+  TimerWheel::Timer t{wheel, [&] { ++fired; }};
+  t.arm(200ms);
+  wheel.advance(t0 + 100ms);
+  // Moving the deadline along, like a write making progress.
+  t.arm(200ms);
+  wheel.advance(t0 + 200ms);
+  expect(fired) == 0;
+  wheel.advance(t0 + 300ms);
+  expect(fired) == 1;
+
+  t.arm(100ms);
+  t.cancel();
+  wheel.advance(t0 + 1s);
+  expect(fired) == 1;
+}
+
+void test_long_deadline() {
+  TimerWheel wheel{100ms, t0};
+  int fired{};
+  TimerWheel::Timer t{wheel, [&] { ++fired; }};
+  // Further than a full turn of the wheel.
+  auto d = TimerWheel::slot_count * 100ms + 500ms;
+  t.arm(d);
+  wheel.advance(t0 + d - 100ms);
+  expect(fired) == 0;
+  wheel.advance(t0 + d);
+  expect(fired) == 1;
+}
+
+void test_hours() {
+  TimerWheel wheel{100ms, t0};
+  int fired{};
+  TimerWheel::Timer t{wheel, [&] { ++fired; }};
+  t.arm(3h);
+  wheel.advance(t0 + 3h - 100ms);
+  expect(fired) == 0;
+  wheel.advance(t0 + 3h);
+  expect(fired) == 1;
+}
+
+// Lots of timers over every wheel, each has to fire on its own tick.
+void test_exact() {
+  TimerWheel wheel{1ms, t0};
+  std::mt19937 rng{1965};
+  constexpr int n = 2000;
+  vector<uint64_t> want(n), got(n);
+  uint64_t now{};
+  vector<std::unique_ptr<TimerWheel::Timer>> timers;
+  for (int i = 0; i < n; ++i) {
+    timers.push_back(std::make_unique<TimerWheel::Timer>(
+        wheel, [&, i] { got[i] = now; }));
+  }
+
+  for (int i = 0; i < n; ++i) {
+    // Spread the deadlines over a few orders of magnitude.
+    auto ticks = std::uniform_int_distribution<uint64_t>{
+        1, uint64_t{1} << std::uniform_int_distribution{1, 20}(rng)}(rng);
+    want[i] = now + ticks;
+    timers[i]->arm(milliseconds{ticks});
+    // Start them at different times, too.
+    if (i % 100 == 99) {
+      for (auto stop = now + 37; now < stop;) wheel.advance(t0 + ++now * 1ms);
+    }
+  }
+  while (now < (uint64_t{1} << 21)) wheel.advance(t0 + ++now * 1ms);
+  for (int i = 0; i < n; ++i) expect(got[i]) == want[i];
+}
+
+void test_callbacks() {
+  TimerWheel wheel{100ms, t0};
+  int fired{};
+  auto other = std::make_unique<TimerWheel::Timer>(wheel, [&] { ++fired; });
+  // A callback that destroys another due timer, and one that re-arms itself.
+  TimerWheel::Timer killer{wheel, [&] { other.reset(); }};
+  TimerWheel::Timer again{wheel, [&] { again.arm(100ms); }};
+  killer.arm(100ms);
+  other->arm(100ms);
+  again.arm(100ms);
+  wheel.advance(t0 + 100ms);
+  expect(fired) == 0;
+  expect(again.armed()) == true;
+}
+
+void test_past() {
+  TimerWheel wheel{100ms, t0};
+  int fired{};
+  TimerWheel::Timer t{wheel, [&] { ++fired; }};
+  // Already due, so the next tick, not some far-off one.
+  t.arm(-1s);
+  wheel.advance(t0 + 100ms);
+  expect(fired) == 1;
+  t.arm(0ms);
+  wheel.advance(t0 + 200ms);
+  expect(fired) == 2;
+  // And the longest doesn't wrap around to now.
+  t.arm(TimerWheel::clock::duration::max());
+  wheel.advance(t0 + 300ms);
+  expect(fired) == 2;
+}
+
+int main() {
+  test_expiry();
+  test_rearm_and_cancel();
+  test_long_deadline();
+  test_hours();
+  test_exact();
+  test_callbacks();
+  test_past();
+}
@@ -0,0 +1,113 @@
+#include <thread>
+
+#include "test.hpp"
+#include "trace.hpp"
+
+using namespace std::chrono_literals;
+
+// A finished trace that took total, all of it in the handler.
+Trace took(Trace::clock::duration total, int status = 20) {
+  Trace t;
+  t.mark(phase_t::accept);
+  t.mark(phase_t::handler);
+  t.mark(phase_t::shutdown);
+  t.end();
+  // Leave out however long the marks took.
+  for (size_t i = 1; i < t.marks.size(); ++i)
+    t.marks[i] = t.marks[0] + (i > static_cast<size_t>(phase_t::handler)
+                                   ? total
+                                   : Trace::clock::duration{});
+  t.status = status;
+  return t;
+}
+
+void test_marks() {
+  Trace t;
+  expect(t.total().count()) == 0;
+  t.mark(phase_t::accept);
+  expect(t.phase()) == "accept";
+  expect(t.ran(phase_t::accept)) == false;
+
+  // Skipping straight to the handler: the phases between took no time.
+  t.mark(phase_t::handler);
+  expect(t.phase()) == "handler";
+  expect(t.ran(phase_t::accept)) == true;
+  expect(t.ran(phase_t::route)) == true;
+  expect(t.duration(phase_t::route).count()) == 0;
+  expect(t.ran(phase_t::handler)) == false;
+
+  // Marking a phase that's already started changes nothing.
+  auto before{t.marks};
+  t.mark(phase_t::request);
+  expect(t.marks == before) == true;
+
+  t.mark(phase_t::shutdown);
+  t.end();
+  expect(t.ran(phase_t::shutdown)) == true;
+  expect(t.total() == t.marks.back() - t.marks.front()) == true;
+  // Once it's over, more ends don't run off the end.
+  t.end();
+  expect(t.reached) == phase_count + 1;
+
+  t.path(string(100, 'x'));
+  expect(t.path().size()) == t.path_buf.size();
+}
+
+void test_keeps_slowest() {
+  SlowTraces slow{3};
+  for (int ms : {5, 1, 9, 3, 7, 2}) slow.offer(took(ms * 1ms, ms));
+  auto kept = slow.take();
+  expect(kept.size()) == 3u;
+  expect(kept[0].status) == 9;
+  expect(kept[1].status) == 7;
+  expect(kept[2].status) == 5;
+
+  // Taking starts over, faster ones and all.
+  expect(slow.take().size()) == 0u;
+  slow.offer(took(1ms));
+  expect(slow.take().size()) == 1u;
+
+  SlowTraces none{0};
+  expect(none.enabled()) == false;
+  none.offer(took(1s));
+  expect(none.take().size()) == 0u;
+}
+
+void test_threads() {
+  SlowTraces slow{10};
+  {
+    vector<std::jthread> threads;
+    for (int i = 0; i < 4; ++i) {
+      threads.emplace_back([&, i] {
+        for (int n = 0; n < 1000; ++n) slow.offer(took(n * 1us + i * 1ns));
+      });
+    }
+  }
+  auto kept = slow.take();
+  expect(kept.size()) == 10u;
+  // The slowest three had 999 µs each, from three different threads.
+  expect(kept[0].total() == 999us + 3ns) == true;
+  expect(kept[9].total() >= 997us) == true;
+}
+
+void test_chrome_json() {
+  auto t = took(2ms, 51);
+  t.path("/a\"b");
+  t.worker = 3;
+  array<Trace, 1> traces{t};
+  auto json = SlowTraces::chrome_json(traces);
+  expect(json.starts_with("{\"traceEvents\":[")) == true;
+  expect(json.find("\"name\":\"connection\"") != string::npos) == true;
+  expect(json.find("\"name\":\"handler\",\"ph\":\"X\"") != string::npos) ==
+      true;
+  expect(json.find("\"dur\":2000") != string::npos) == true;
+  expect(json.find("\"args\":{\"path\":\"/a\\\"b\",\"status\":51,"
+                   "\"worker\":3}") != string::npos) == true;
+}
+
+int main() {
+  test_marks();
+  test_keeps_slowest();
+  test_threads();
+  test_chrome_json();
+}
@@ -1,11 +1,9 @@
 #include <source_location>
 
-#include "uri.hpp"
+#include <random>
 
-std::ostream& operator<<(std::ostream& os, std::source_location loc) {
-  return os << loc.file_name() << ':' << loc.function_name() << ':'
-            << loc.line() << ':' << loc.column();
-}
+#include "percent.hpp"
+#include "uri.hpp"
 
 std::ostream& operator<<(std::ostream& os, std::errc ec) {
   return os << std::make_error_code(ec).message();
@@ -24,29 +22,7 @@ std::ostream& operator<<(std::ostream& os, const pair<T, U>& ec) {
   return os << '(' << ec.first << ", " << ec.second;
 }
 
-template <typename T>
-concept Streamable = requires(T t, std::ostream& os) {
-  { os << t } -> std::same_as<std::ostream&>;
-};
-
-template <Streamable T>
-struct expecter {
-  T got;
-  std::source_location loc;
-
-  template <Streamable U>
-  void operator==(U expected) {
-    if (got != expected) {
-      cerr << loc << " Expected: " << expected << " Got: " << got << '\n';
-      std::exit(1);
-    }
-  }
-};
-
-template <Streamable T>
-auto expect(T got, std::source_location loc = std::source_location::current()) {
-  return expecter<T>{got, loc};
-}
+#include "test.hpp"
 
 using data_t = struct {
   string_view scheme, host, port, path;
@@ -213,8 +189,100 @@ void test_url_decode() {
   }
 }
 
+void test_uri_view() {
+  for (auto&& in : std::initializer_list<string_view>{
+           "gemini://example.com/",
+           "gemini://example.com:1966/foo/../bar/./baz%20qux?a=b%26c",
+           "gemini://example.com/a//b/%2e%2e/c/",
+           "gemini://example.com/%2e%2e/%2E%2E/etc/passwd",
+           "gemini://[::1]/foo/bar/..?q",
+           "foo/bar/../../..",
+           "gemini:",
+           "",
+       }) {
+    string buf{in};
+    auto res = url::UriView::parse(buf);
+    expect(res.index()) == 0;
+    auto& u = std::get<0>(res);
+    url::Uri ref{in};
+    expect(u.scheme()) == ref.scheme();
+    expect(u.host()) == ref.host();
+    expect(u.port()) == ref.port();
+    expect(u.path()) == string_view{ref.path().native()};
+    expect(url::Uri{u}.query()) == ref.query();
+  }
+
+  string frag{"/a#b%20c"};
+  auto res = url::UriView::parse(frag);
+  expect(std::get<0>(res).fragment()) == "b c";
+
+  for (auto&& in : std::initializer_list<string_view>{
+           "/a%2",
+           "/a?b=%zz",
+           "/a?b=%2",
+           "/a#%",
+       }) {
+    string buf{in};
+    auto res = url::UriView::parse(buf);
+    expect(res.index()) == 1;
+  }
+}
+
+void test_codecs() {
+  expect(url::encode("caf\xc3\xa9 #1")) == "caf%c3%a9%20%231";
+  array<char, 15> buf;
+  expect(string_view{buf.data(),
+                     url::encode("a?b&c", buf.data(), url::charset::path)}) ==
+      "a%3fb&c";
+
+  // Every codec has to agree with the scalar one, on inputs long enough to
+  // go through their block loops and with escapes straddling blocks.
+  auto codecs = url::detail::codecs();
+  auto& scalar = codecs.front();
+  std::mt19937 rng{1965};
+  constexpr string_view alphabet{"%%%0123456789abcdefABCDEF/?&=._~ #\x80\xff"};
+
+  for (int i = 0; i < 20000; ++i) {
+    string in(rng() % 100, '\0');
+    for (auto& c : in) c = alphabet[rng() % alphabet.length()];
+
+    string want(in.length(), '\0');
+    auto want_res = scalar.decode(in, want.data());
+    for (auto& c : codecs) {
+      string got(in.length(), '\0');
+      auto res = c.decode(in, got.data());
+      expect(res.index()) == want_res.index();
+      if (res.index() == 0) {
+        expect(got.substr(0, std::get<0>(res))) ==
+            want.substr(0, std::get<0>(want_res));
+      }
+
+      string in_place{in};
+      res = c.decode(in_place, in_place.data());
+      expect(res.index()) == want_res.index();
+      if (res.index() == 0) {
+        expect(in_place.substr(0, std::get<0>(res))) ==
+            want.substr(0, std::get<0>(want_res));
+      }
+    }
+
+    for (auto allowed : {url::charset::uri, url::charset::path,
+                         url::charset::query}) {
+      string want(3 * in.length(), '\0');
+      want.resize(scalar.encode(in, want.data(), allowed));
+      for (auto& c : codecs) {
+        string got(3 * in.length(), '\0');
+        got.resize(c.encode(in, got.data(), allowed));
+        expect(got) == want;
+      }
+    }
+  }
+}
+
 int main() {
   test_url_decode();
+  test_codecs();
+  test_uri_view();
   test_uri();
   test_encode();
   test_base_url();
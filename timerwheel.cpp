@@ -0,0 +1,66 @@
+#include "timerwheel.hpp"
+
+void TimerWheel::Timer::arm(clock::duration d) noexcept {
+  unlink();
+  // Round up, and never into the tick advance() has already done; a
+  // deadline already past is the next tick too.
+  // Dividing first, so even duration::max() doesn't overflow.
+  uint64_t ticks{1};
+  if (d > clock::duration::zero()) {
+    ticks = d / wheel._tick;
+    if (d % wheel._tick != clock::duration::zero()) ++ticks;
+  }
+  expiry = wheel.current + ticks;
+  wheel.insert(*this);
+}
+
+void TimerWheel::insert(Timer& t) noexcept {
+  constexpr uint64_t max_delta{(uint64_t{1} << (slot_bits * level_count)) - 1};
+  auto delta = t.expiry - current;
+  if (delta > max_delta) {
+    t.expiry = current + max_delta;
+    delta = max_delta;
+  }
+  // The first wheel whose turn covers it.
+  size_t level{};
+  while (level + 1 < level_count &&
+         delta >= uint64_t{1} << (slot_bits * (level + 1)))
+    ++level;
+  auto slot = (t.expiry >> (slot_bits * level)) & (slot_count - 1);
+  levels[level][slot].push_back(t);
+}
+
+void TimerWheel::advance(clock::time_point now) {
+  uint64_t target = (now - origin) / _tick;
+  while (current < target) {
+    ++current;
+
+    // Each wheel that's come round pulls down the next slot of the one
+    // above; the highest first, so its timers can fall through.
+    size_t top{};
+    while (top + 1 < level_count &&
+           (current & ((uint64_t{1} << (slot_bits * (top + 1))) - 1)) == 0)
+      ++top;
+    for (auto level = top; level > 0; --level) {
+      auto& slot =
+          levels[level][(current >> (slot_bits * level)) & (slot_count - 1)];
+      list moving;
+      moving.splice(moving.end(), slot);
+      while (!moving.empty()) {
+        auto& t = moving.front();
+        moving.pop_front();
+        insert(t);
+      }
+    }
+
+    // Everything left in this slot is due. Take it all out before running
+    // anything, since a callback can re-arm or destroy any timer.
+    list due;
+    due.splice(due.end(), levels[0][current & (slot_count - 1)]);
+    while (!due.empty()) {
+      auto& t = due.front();
+      due.pop_front();
+      t.on_expiry();
+    }
+  }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <boost/core/noncopyable.hpp>
+#include <boost/intrusive/list.hpp>
+#include <chrono>
+#include <functional>
+
+#include "types.hpp"
+
+/**
+ * TimerWheel keeps deadlines for one thread's connections in a hierarchy of
+ * wheels. The first has a slot per tick; each one after it has a slot per
+ * turn of the one before. Arming, re-arming and cancelling a Timer is a
+ * couple of pointer swaps, with no allocation, no clock read and no syscall,
+ * so a connection can move its deadline on every write. Whoever owns the
+ * wheel calls advance() once a tick.
+ *
+ * @par
+ * When a wheel comes round, the timers in its next slot up move down to
+ * where they now belong, so advance() only ever looks at timers that are
+ * due or about to be, however many there are. Deadlines are rounded up to
+ * the next tick, and ones past the last wheel (19 days at 100 ms) are
+ * brought in to it. Nothing here is thread-safe.
+ */
+class TimerWheel : boost::noncopyable {
+ public:
+  using clock = std::chrono::steady_clock;
+
+  static constexpr unsigned slot_bits{6};
+  static constexpr size_t slot_count{1 << slot_bits};
+  static constexpr size_t level_count{4};
+
+  class Timer : public boost::intrusive::list_base_hook<
+                    boost::intrusive::link_mode<boost::intrusive::auto_unlink>> {
+   public:
+    /// on_expiry runs from advance(). It may re-arm or destroy the Timer.
+    Timer(TimerWheel& _wheel, std::function<void()> _on_expiry)
+        : wheel{_wheel}, on_expiry{std::move(_on_expiry)} {}
+
+    /// Expire d from now, instead of whenever it was going to.
+    void arm(clock::duration d) noexcept;
+    void cancel() noexcept { unlink(); }
+    bool armed() const noexcept { return is_linked(); }
+
+   private:
+    friend TimerWheel;
+    TimerWheel& wheel;
+    std::function<void()> on_expiry;
+    uint64_t expiry{};
+  };
+
+  explicit TimerWheel(clock::duration tick = std::chrono::milliseconds{100},
+                      clock::time_point now = clock::now())
+      : _tick{tick}, origin{now} {}
+
+  clock::duration tick() const noexcept { return _tick; }
+
+  /// Expire every Timer due by now.
+  void advance(clock::time_point now);
+
+ private:
+  using list = boost::intrusive::list<
+      Timer, boost::intrusive::constant_time_size<false>>;
+
+  const clock::duration _tick;
+  const clock::time_point origin;
+  // Ticks since origin that advance() has dealt with.
+  uint64_t current{};
+  array<array<list, slot_count>, level_count> levels;
+
+  void insert(Timer&) noexcept;
+};
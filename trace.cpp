@@ -0,0 +1,94 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+namespace {
+
+bool slower(const Trace& a, const Trace& b) { return a.total() > b.total(); }
+
+long long micros(Trace::clock::duration d) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+// A JSON string, escaped.
+string quoted(string_view s) {
+  string q{'"'};
+  for (unsigned char c : s) {
+    if (c == '"' || c == '\\') {
+      q += '\\';
+      q += c;
+    } else if (c < 0x20) {
+      char esc[7];
+      std::snprintf(esc, sizeof esc, "\\u%04x", c);
+      q += esc;
+    } else {
+      q += c;
+    }
+  }
+  q += '"';
+  return q;
+}
+
+}  // namespace
+
+void SlowTraces::offer(const Trace& t) {
+  if (keep == 0 || t.total().count() <= floor.load(std::memory_order_relaxed))
+    return;
+
+  std::scoped_lock lock{mutex};
+  if (heap.size() == keep) {
+    if (!slower(t, heap.front())) return;
+    std::ranges::pop_heap(heap, slower);
+    heap.back() = t;
+  } else {
+    heap.push_back(t);
+  }
+  std::ranges::push_heap(heap, slower);
+  if (heap.size() == keep)
+    floor.store(heap.front().total().count(), std::memory_order_relaxed);
+}
+
+vector<Trace> SlowTraces::take() {
+  vector<Trace> out;
+  {
+    std::scoped_lock lock{mutex};
+    out.swap(heap);
+    floor.store(0, std::memory_order_relaxed);
+  }
+  std::ranges::sort(out, slower);
+  return out;
+}
+
+string SlowTraces::chrome_json(std::span<const Trace> traces) {
+  std::ostringstream out;
+  out << "{\"traceEvents\":[";
+  bool first{true};
+  auto event = [&](string_view name, size_t row, Trace::clock::time_point at,
+                   Trace::clock::duration d, string_view args) {
+    out << (first ? "\n" : ",\n") << "{\"name\":" << quoted(name)
+        << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << row
+        << ",\"ts\":" << micros(at.time_since_epoch())
+        << ",\"dur\":" << micros(d);
+    if (!args.empty()) out << ",\"args\":" << args;
+    out << '}';
+    first = false;
+  };
+
+  for (size_t row{}; row < traces.size(); ++row) {
+    auto& t{traces[row]};
+    if (t.reached < 2) continue;
+    auto args{"{\"path\":" + quoted(t.path()) +
+              ",\"status\":" + std::to_string(t.status) +
+              ",\"worker\":" + std::to_string(t.worker) + '}'};
+    event("connection", row, t.marks[0], t.total(), args);
+    for (size_t p{}; p < phase_count; ++p) {
+      if (t.ran(static_cast<phase_t>(p)))
+        event(phase_names[p], row, t.marks[p],
+              t.duration(static_cast<phase_t>(p)), {});
+    }
+  }
+  out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+  return out.str();
+}
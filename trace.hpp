@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <boost/core/noncopyable.hpp>
+#include <chrono>
+#include <mutex>
+#include <span>
+
+#include "types.hpp"
+
+/// What a connection spends its time on, in order.
+enum class phase_t : uint8_t {
+  accept,     // Accepted, waiting for the worker to start on it.
+  handshake,  // TLS.
+  request,    // Reading and parsing the request line.
+  route,      // Finding the handler.
+  handler,    // The handler, its body and the rest of the response.
+  shutdown,   // TLS close_notify.
+};
+inline constexpr size_t phase_count{6};
+inline constexpr array<string_view, phase_count> phase_names{
+    "accept", "handshake", "request", "route", "handler", "shutdown"};
+
+/**
+ * Trace is when each phase of one connection began. It's fixed-size, so
+ * keeping one costs a few clock reads and nothing else.
+ */
+struct Trace {
+  using clock = std::chrono::steady_clock;
+
+  /// The start of each phase so far, then the end of the last one.
+  array<clock::time_point, phase_count + 1> marks{};
+  /// How many marks are set.
+  uint8_t reached{};
+  uint8_t worker{};
+  int status{};
+  uint8_t path_length{};
+  array<char, 64> path_buf{};
+
+  /// The phase p starts now, and whatever came before it ends. Phases
+  /// skipped on the way took no time.
+  void mark(phase_t p) noexcept {
+    auto now{clock::now()};
+    for (; reached <= static_cast<size_t>(p); ++reached) marks[reached] = now;
+  }
+  /// The last phase ends now.
+  void end() noexcept {
+    if (reached < marks.size()) marks[reached++] = clock::now();
+  }
+
+  /// The name of the phase under way.
+  string_view phase() const noexcept {
+    return phase_names[std::clamp<size_t>(reached, 1, phase_count) - 1];
+  }
+
+  /// Phase p ran from marks[p] to the next mark; false if it didn't run.
+  bool ran(phase_t p) const noexcept {
+    return static_cast<size_t>(p) + 1 < reached;
+  }
+  clock::duration duration(phase_t p) const noexcept {
+    auto i{static_cast<size_t>(p)};
+    return marks[i + 1] - marks[i];
+  }
+  clock::duration total() const noexcept {
+    return reached > 1 ? marks[reached - 1] - marks[0] : clock::duration{};
+  }
+
+  void path(string_view p) noexcept {
+    path_length = static_cast<uint8_t>(std::min(p.size(), path_buf.size()));
+    std::copy_n(p.begin(), path_length, path_buf.begin());
+  }
+  string_view path() const noexcept { return {path_buf.data(), path_length}; }
+};
+
+/**
+ * SlowTraces keeps the slowest Traces offered to it, up to keep of them,
+ * until they're taken. Offers that couldn't make the cut are turned away
+ * with one relaxed load, so only the slow ones ever take the lock.
+ */
+class SlowTraces : boost::noncopyable {
+ public:
+  explicit SlowTraces(size_t _keep) : keep{_keep} {}
+
+  /// False if keep is 0 and offers are all turned away.
+  bool enabled() const noexcept { return keep > 0; }
+
+  void offer(const Trace&);
+
+  /// What's been kept, slowest first, and start over.
+  vector<Trace> take();
+
+  /// traces as Chrome trace-event JSON, for chrome://tracing or Perfetto:
+  /// a row per trace, with a slice per phase.
+  static string chrome_json(std::span<const Trace> traces);
+
+ private:
+  const size_t keep;
+  // Once full, the shortest total kept; nothing shorter gets in.
+  std::atomic<Trace::clock::rep> floor{};
+  std::mutex mutex;
+  // A min-heap on total().
+  vector<Trace> heap;
+};
@@ -3,6 +3,7 @@
 #include <cassert>
 #include <cctype>
 #include <charconv>
+#include <cstring>
 #include <ranges>
 #include <sstream>
 #include <stdexcept>
@@ -11,43 +12,12 @@
 namespace url {
 
 std::errc decode(string &s) {
-  string::size_type left{s.find('%', left)};
-  if (left == string::npos)
-    // No valid % sequences
-    return std::errc();
+  auto res{decode(s, s.data())};
+  if (auto ec{std::get_if<std::errc>(&res)}; ec) return *ec;
 
-  string_view in{&s[left], s.length() - left};
-
-  for (auto out{&s[left]};;) {
-    if (in.length() < 3)
-      // Invalid; truncated % at end
-      return std::errc::invalid_argument;
-
-    uint8_t val;
-
-    auto res{std::from_chars(&in[1], &in[3], val, 16)};
-    if (res.ptr != &in[3]) {
-      return std::errc::invalid_argument;
-    }
-
-    in.remove_prefix(3);
-
-    *out = val;
-    ++out;
-
-    auto right{in.find('%')};
-    if (right == string_view::npos) {
-      // No more '%' escapes
-      std::copy(in.begin(), in.end(), out);
-      out += in.length();
-      s.erase(string::iterator{out}, s.end());
-      if (s.capacity() >> 1 > s.length()) s.shrink_to_fit();
-      return std::errc();
-    }
-    std::copy(in.begin(), in.begin()+right, out);
-    out += right;
-    in.remove_prefix(right);
-  }
+  s.resize(std::get<size_t>(res));
+  if (s.capacity() >> 1 > s.length()) s.shrink_to_fit();
+  return std::errc();
 }
 
 std::variant<string, std::errc> decode(string_view s) {
@@ -187,30 +157,79 @@ std::variant<Uri::query_t, std::errc> parse_query(string_view s) {
   return ret;
 }
 
-const string_view urlchars{
-    "!$&'()*+,-./"
-    "0123456789:;=?@ABCDEFGHIJKLMNOPQRSTUVWXYZ_~abcdefghijklmnopqrstuvwxyz"};
-const string_view path_urlchars{
-    "!$&'()*+,-./"
-    "0123456789:;=@ABCDEFGHIJKLMNOPQRSTUVWXYZ_~abcdefghijklmnopqrstuvwxyz"};
-const string_view query_urlchars{
-    "!$'()*+,-./"
-    "0123456789:;=?@ABCDEFGHIJKLMNOPQRSTUVWXYZ_~abcdefghijklmnopqrstuvwxyz"};
+char *normalize(char *first, char *last) noexcept {
+  if (first == last) return last;
+
+  const bool absolute{*first == '/'}, trailing{last[-1] == '/'};
+  // The output never outgrows what's been read, so write over the input.
+  auto out{absolute ? first + 1 : first};
+  // Number of segments in the output that a ".." can remove.
+  size_t depth{};
+
+  auto separate = [&] {
+    if (out != first && out[-1] != '/') *out++ = '/';
+  };
+
+  for (auto in{first}; in != last;) {
+    if (*in == '/') {
+      ++in;
+      continue;
+    }
+    auto end{std::find(in, last, '/')};
+    string_view seg{in, end};
+    in = end;
+
+    if (seg == ".") {
+      separate();
+    } else if (seg == "..") {
+      if (depth > 0) {
+        // Drop the last segment, keeping the separator before it.
+        if (out[-1] == '/') --out;
+        while (out != first && out[-1] != '/') --out;
+        --depth;
+      } else if (!absolute) {
+        separate();
+        *out++ = '.';
+        *out++ = '.';
+      }
+      // Otherwise we're at the root, where ".." is a no-op.
+    } else {
+      separate();
+      std::memmove(out, seg.data(), seg.length());
+      out += seg.length();
+      ++depth;
+    }
+  }
+
+  // Keep a trailing separator, except after "..".
+  if (trailing) separate();
+  if (string_view res{first, out}; res == "../" || res.ends_with("/../")) --out;
+  if (out == first) *out++ = '.';
+  return out;
+}
+
+/// Checks that every '%' in s starts a well-formed % sequence.
+bool valid_escapes(string_view s) noexcept {
+  for (auto right{s.find('%')}; right != string_view::npos;
+       right = s.find('%', right + 3)) {
+    if (right + 2 >= s.length() || !std::isxdigit(s[right + 1]) ||
+        !std::isxdigit(s[right + 2]))
+      return false;
+  }
+  return true;
+}
 
 struct urlencoder {
   string_view s;
-  string_view allowed{urlchars};
+  charset allowed{charset::uri};
 };
 
 std::ostream &operator<<(std::ostream &os, const urlencoder &u) {
+  array<char, 3 * 256> buf;
   for (auto s = u.s; !s.empty();) {
-    auto right = s.find_first_not_of(u.allowed);
-    if (right == string_view::npos) {
-      os << s;
-      break;
-    }
-    os << s.substr(0, right) << '%' << std::setw(2) << std::setfill('0') << std::hex << int{s[right]};
-    s.remove_prefix(right + 1);
+    auto chunk = s.substr(0, buf.size() / 3);
+    os.write(buf.data(), encode(chunk, buf.data(), u.allowed));
+    s.remove_prefix(chunk.length());
   }
   return os;
 }
@@ -218,16 +237,71 @@ std::ostream &operator<<(std::ostream &os, const urlencoder &u) {
 }  // namespace detail
 
 string encode(string_view s) {
-  std::ostringstream os;
-  os << detail::urlencoder{s};
-  return os.str();
+  string out(3 * s.length(), '\0');
+  out.resize(encode(s, out.data()));
+  return out;
+}
+
+/*
+ * URIVIEW IMPLEMENTATION
+ */
+std::variant<UriView, std::errc> UriView::parse(std::span<char> buf) {
+  detail::parser p{{buf.data(), buf.size()}};
+  // p's parts view into buf, so this finds where to decode each in place.
+  auto in_place = [&](string_view part) {
+    return buf.data() + (part.data() - buf.data());
+  };
+
+  UriView u;
+  u._scheme = p.scheme;
+  u._host = p.host;
+  u._port = p.port;
+
+  if (!p.path.empty()) {
+    auto first{in_place(p.path)};
+    auto res{decode(p.path, first)};
+    if (res.index() == 1) return std::get<1>(res);
+    auto last{detail::normalize(first, first + std::get<0>(res))};
+    u._path = {first, last};
+  }
+
+  if (!detail::valid_escapes(p.query)) return std::errc::invalid_argument;
+  u._query = p.query;
+
+  if (!p.fragment.empty()) {
+    auto first{in_place(p.fragment)};
+    auto res{decode(p.fragment, first)};
+    if (res.index() == 1) return std::get<1>(res);
+    u._fragment = {first, std::get<0>(res)};
+  }
+
+  return u;
 }
 
+string_view UriView::scheme() const noexcept { return _scheme; }
+string_view UriView::host() const noexcept { return _host; }
+string_view UriView::port() const noexcept { return _port; }
+string_view UriView::path() const noexcept { return _path; }
+string_view UriView::query() const noexcept { return _query; }
+string_view UriView::fragment() const noexcept { return _fragment; }
+
 /*
  * URI IMPLEMENTATION
  */
 Uri::Uri(string_view s) : Uri{detail::parser{s}, nullptr} {}
 Uri::Uri(string_view s, const Uri &base) : Uri{detail::parser{s}, &base} {}
+Uri::Uri(const UriView &u)
+    : _scheme{u.scheme()},
+      _host{u.host()},
+      _port{u.port()},
+      _path{u.path()},
+      _fragment{u.fragment()} {
+  auto maybeQuery = detail::parse_query(u.query());
+  if (maybeQuery.index() == 1) {
+    throw std::invalid_argument{"Invalid URL"};
+  }
+  _query = std::move(std::get<0>(maybeQuery));
+}
 Uri::Uri(detail::parser p, const Uri *base) {
   string decoded_path{p.path};
   if (decode(decoded_path) != std::errc()) {
@@ -321,7 +395,7 @@ std::ostream &operator<<(std::ostream &os, const Uri &u) {
       os << '/';
     }
   }
-  os << detail::urlencoder{u.path().native(), detail::path_urlchars};
+  os << detail::urlencoder{u.path().native(), charset::path};
   if (!u.query().empty()) {
     os << '?';
     auto first{true};
@@ -332,9 +406,9 @@ std::ostream &operator<<(std::ostream &os, const Uri &u) {
       }
       first = false;
 
-      os << detail::urlencoder{k, detail::query_urlchars};
+      os << detail::urlencoder{k, charset::query};
       if (!v.empty()) {
-        os << '=' << detail::urlencoder{v, detail::query_urlchars};
+        os << '=' << detail::urlencoder{v, charset::query};
       }
     }
   }
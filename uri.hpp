@@ -3,6 +3,7 @@
 
 #include <filesystem>
 #include <map>
+#include <span>
 #include <system_error>
 #include <variant>
 
@@ -18,6 +19,24 @@ namespace url {
  */
 std::errc decode(string &);
 
+/**
+ * decode(in, out) decodes '%' references in `in`, writing the result to out.
+ * out must have room for in.length() chars; it may be in.data() itself to
+ * decode in place. It returns the number of chars written, or
+ * std::errc::invalid_argument if `in` contains malformed % sequences.
+ */
+std::variant<size_t, std::errc> decode(string_view in, char *out);
+
+/// The sets of chars that encode() leaves alone.
+enum class charset {
+  /// Anything allowed anywhere in a URI.
+  uri,
+  /// Path segments; no '?'.
+  path,
+  /// Query keys and values; no '&'.
+  query,
+};
+
 /**
  * @brief Encodes non-URL codepoints as % sequences.
  * 
@@ -25,6 +44,13 @@ std::errc decode(string &);
  */
 string encode(string_view);
 
+/**
+ * encode(in, out, allowed) writes `in` to out, encoding every char not in
+ * allowed as a % sequence. out must have room for 3 * in.length() chars. It
+ * returns the number of chars written.
+ */
+size_t encode(string_view in, char *out, charset allowed = charset::uri);
+
 /**
  * decode(s) decodes '%' references in s. It returns a pair of
  * std::errc and std::string. std::errc is std::errc::invalid_argument if s
@@ -35,7 +61,35 @@ std::variant<string, std::errc> decode(string_view);
 
 namespace detail {
 struct parser;
-}
+
+/**
+ * normalize(first, last) lexically normalizes the path in [first, last) in
+ * place, the same as std::filesystem::path::lexically_normal(), and returns
+ * its new end.
+ */
+char *normalize(char *first, char *last) noexcept;
+}  // namespace detail
+
+/**
+ * UriView segments a URI into its component parts without owning any memory.
+ * Parsing decodes the path and fragment and normalizes the path in place, so
+ * it modifies the buffer it's given, and the buffer must outlive the
+ * UriView. The query is left encoded. Nothing allocates.
+ */
+class UriView {
+ public:
+  UriView() = default;
+
+  /// Parse the URI in buf, or return std::errc::invalid_argument.
+  static std::variant<UriView, std::errc> parse(std::span<char> buf);
+
+  string_view scheme() const noexcept, host() const noexcept,
+      port() const noexcept, path() const noexcept, query() const noexcept,
+      fragment() const noexcept;
+
+ private:
+  string_view _scheme, _host, _port, _path, _query, _fragment;
+};
 
 /**
  * Uri segments a URI into its component parts. It owns
@@ -52,6 +106,9 @@ class Uri {
   /// Parse a URI and resolve against a base URI
   Uri(string_view, const Uri &);
 
+  /// Copy a parsed URI
+  explicit Uri(const UriView &);
+
   string_view scheme() const noexcept, host() const noexcept,
       port() const noexcept, fragment() const noexcept;
   const path_t &path() const noexcept;
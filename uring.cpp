@@ -0,0 +1,223 @@
+#include "uring.hpp"
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <stdexcept>
+
+#if CASTOR_URING
+
+namespace {
+
+thread_local FileRing* current{};
+
+[[noreturn]] void throw_uring(int ret, const char* what) {
+  throw system_error{err{-ret, boost::system::system_category()}, what};
+}
+
+}  // namespace
+
+FileRing::FileRing(io_context& _io, Options _options)
+    : options{_options}, io{_io}, events{std::in_place, _io} {
+  if (auto ret = io_uring_queue_init(2 * options.buffers, &ring, 0); ret < 0)
+    throw_uring(ret, "io_uring_queue_init");
+
+  slab.resize(options.buffers * options.buffer_size);
+  vector<iovec> iovs(options.buffers);
+  for (unsigned i = 0; i < options.buffers; ++i) {
+    iovs[i] = {slab.data() + i * options.buffer_size, options.buffer_size};
+    free_buffers.push_back(options.buffers - 1 - i);
+  }
+  reads.resize(options.buffers);
+  if (auto ret = io_uring_register_buffers(&ring, iovs.data(), iovs.size());
+      ret < 0) {
+    io_uring_queue_exit(&ring);
+    throw_uring(ret, "io_uring_register_buffers");
+  }
+  // Without a table every read just passes its fd.
+  if (io_uring_register_files_sparse(&ring, options.files) == 0) {
+    slot_fds.resize(options.files, -1);
+    for (int i = options.files; i > 0; --i) free_files.push_back(i - 1);
+  }
+
+  int efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (efd < 0 || io_uring_register_eventfd(&ring, efd) < 0) {
+    if (efd >= 0) ::close(efd);
+    io_uring_queue_exit(&ring);
+    throw system_error{err{errno, boost::system::system_category()},
+                       "io_uring_register_eventfd"};
+  }
+  events->assign(efd);
+  co_spawn(io, reap(), detached);
+  current = this;
+}
+
+FileRing::~FileRing() {
+  if (current == this) current = nullptr;
+  io_uring_queue_exit(&ring);
+}
+
+FileRing* FileRing::local() noexcept { return current; }
+
+io_uring_sqe* FileRing::get_sqe() {
+  auto sqe = io_uring_get_sqe(&ring);
+  if (!sqe) {
+    // Full of what's waiting to go; send it and try again.
+    io_uring_submit(&ring);
+    sqe = io_uring_get_sqe(&ring);
+  }
+  if (!sqe) throw_uring(-EBUSY, "io_uring_get_sqe");
+  return sqe;
+}
+
+// The slots stay registered between files. Putting an fd in one, and taking
+// it out again, are FILES_UPDATEs queued on the ring itself, so they go to
+// the kernel with reads that are going anyway rather than costing syscalls
+// of their own.
+FileRing::File FileRing::add(int fd) {
+  if (free_files.empty()) return {*this, fd, -1};
+  auto slot = free_files.back();
+  free_files.pop_back();
+  return {*this, fd, slot};
+}
+
+FileRing::File::~File() {
+  if (slot < 0) return;
+  // Empty the slot, so it doesn't keep the file open once its fd is closed.
+  // A file that later takes the slot is queued after this. A closing ring
+  // drops the whole table soon enough.
+  if (placed && !ring.closing) {
+    auto sqe = ring.get_sqe();
+    io_uring_prep_files_update(sqe, &ring.no_fd, 1, slot);
+    io_uring_sqe_set_data64(sqe, 0);
+    ring.flush_later();
+  }
+  ring.free_files.push_back(slot);
+}
+
+void FileRing::flush_later() {
+  if (std::exchange(flush_posted, true)) return;
+  // Busy, a read submits it first and this finds nothing left to do.
+  asio::post(io, [this] {
+    flush_posted = false;
+    if (io_uring_sq_ready(&ring) > 0) io_uring_submit(&ring);
+  });
+}
+
+std::optional<FileRing::Buffer> FileRing::buffer() {
+  if (free_buffers.empty()) return {};
+  auto i = free_buffers.back();
+  free_buffers.pop_back();
+  return Buffer{this, i};
+}
+
+FileRing::Buffer::~Buffer() {
+  if (ring) ring->free_buffers.push_back(index);
+}
+
+char* FileRing::Buffer::data() const noexcept {
+  return ring->slab.data() + index * ring->options.buffer_size;
+}
+
+awaitable<size_t> FileRing::read(File& f, const Buffer& buf, off_t offset,
+                                 size_t n) {
+  return asio::async_initiate<const asio::use_awaitable_t<>&,
+                              void(err, size_t)>(
+      [&, offset, n](handler_t handler) {
+        if (f.slot >= 0 && !f.placed) {
+          slot_fds[f.slot] = f.fd;
+          auto sqe = get_sqe();
+          io_uring_prep_files_update(sqe, &slot_fds[f.slot], 1, f.slot);
+          io_uring_sqe_set_data64(sqe, 0);
+          // The read waits for it.
+          io_uring_sqe_set_flags(sqe, IOSQE_IO_LINK);
+          f.placed = true;
+        }
+        auto sqe = get_sqe();
+        io_uring_prep_read_fixed(sqe, f.slot >= 0 ? f.slot : f.fd, buf.data(),
+                                 std::min(n, buf.size()), offset, buf.index);
+        if (f.slot >= 0) io_uring_sqe_set_flags(sqe, IOSQE_FIXED_FILE);
+        uint64_t data = buf.index + 1;
+        io_uring_sqe_set_data64(sqe, data);
+
+        auto& r = reads[buf.index];
+        r.cancel_slot = asio::get_associated_cancellation_slot(handler);
+        if (r.cancel_slot.is_connected()) {
+          r.cancel_slot.assign([this, data](asio::cancellation_type type) {
+            if (type != asio::cancellation_type::none) cancel(data);
+          });
+        }
+        r.handler.emplace(std::move(handler));
+        ++in_flight;
+        io_uring_submit(&ring);
+      },
+      asio::use_awaitable);
+}
+
+void FileRing::cancel(uint64_t data) {
+  auto sqe = get_sqe();
+  io_uring_prep_cancel64(sqe, data, 0);
+  io_uring_sqe_set_data64(sqe, 0);
+  io_uring_submit(&ring);
+}
+
+void FileRing::close() {
+  closing = true;
+  if (in_flight == 0) {
+    if (events) events->close();
+    return;
+  }
+  auto sqe = get_sqe();
+  io_uring_prep_cancel64(sqe, 0, IORING_ASYNC_CANCEL_ANY);
+  io_uring_sqe_set_data64(sqe, 0);
+  io_uring_submit(&ring);
+}
+
+awaitable<void> FileRing::reap() {
+  uint64_t count;
+  while (events->is_open()) {
+    err ec;
+    co_await events->async_read_some(
+        asio::buffer(&count, sizeof count),
+        asio::redirect_error(asio::use_awaitable, ec));
+    if (ec) break;
+
+    io_uring_cqe* cqe;
+    while (io_uring_peek_cqe(&ring, &cqe) == 0) {
+      auto data = io_uring_cqe_get_data64(cqe);
+      auto result = cqe->res;
+      io_uring_cqe_seen(&ring, cqe);
+      // Slot updates and cancellations.
+      if (data == 0) continue;
+      --in_flight;
+
+      auto& r = reads[data - 1];
+      if (r.cancel_slot.is_connected()) r.cancel_slot.clear();
+      asio::post(asio::get_associated_executor(*r.handler),
+                 [h = std::move(*r.handler), result]() mutable {
+                   if (result < 0)
+                     std::move(h)(
+                         err{-result, boost::system::system_category()}, 0);
+                   else
+                     std::move(h)(err{}, static_cast<size_t>(result));
+                 });
+      r.handler.reset();
+    }
+    if (closing && in_flight == 0) events->close();
+  }
+  events.reset();
+}
+
+#else
+
+FileRing::FileRing(io_context&, Options) {
+  throw std::runtime_error{"io_uring is unavailable: built without liburing"};
+}
+
+FileRing::~FileRing() = default;
+
+FileRing* FileRing::local() noexcept { return nullptr; }
+
+void FileRing::close() {}
+
+#endif
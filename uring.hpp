@@ -0,0 +1,131 @@
+#pragma once
+
+#if __has_include(<liburing.h>)
+#include <liburing.h>
+#define CASTOR_URING 1
+#else
+#define CASTOR_URING 0
+#endif
+
+#include <boost/core/noncopyable.hpp>
+#include <optional>
+
+#include "net-types.hpp"
+
+/**
+ * FileRing is a worker's own io_uring for reading files. Its buffers are
+ * registered with the kernel up front, and so is a table of file slots that
+ * files take turns in, so a read neither pins and unpins pages nor looks
+ * the fd up in the file table.
+ *
+ * @par
+ * Completions are signalled on an eventfd that the worker's io_context
+ * watches, so waiting on a FileRing is like waiting on any other asio
+ * operation, cancellation included. It's only for the thread that made it;
+ * local() finds it.
+ *
+ * @par
+ * It needs liburing. Built without it, CASTOR_URING is 0, available is
+ * false, there's never a local() ring, and making one throws.
+ */
+class FileRing : boost::noncopyable {
+ public:
+  struct Options {
+    bool enabled{};
+    /// Registered buffers, and how big each one is.
+    unsigned buffers{64};
+    size_t buffer_size{1 << 16};
+    /// Slots in the registered file table.
+    unsigned files{1024};
+  };
+
+  static constexpr bool available{CASTOR_URING};
+
+  FileRing(io_context&, Options);
+  ~FileRing();
+
+  /// The ring made on this thread, or nullptr.
+  static FileRing* local() noexcept;
+
+  /// Cancel what's in flight and stop watching for completions, so the
+  /// io_context can run out of work.
+  void close();
+
+#if CASTOR_URING
+  /// A file descriptor in a slot of the registered table, or just the fd if
+  /// the table is full. The caller still owns the fd, and keeps it open
+  /// until the File is gone.
+  class File : boost::noncopyable {
+   public:
+    ~File();
+
+   private:
+    friend FileRing;
+    File(FileRing& _ring, int _fd, int _slot)
+        : ring{_ring}, fd{_fd}, slot{_slot} {}
+
+    FileRing& ring;
+    const int fd;
+    // -1 for none.
+    const int slot;
+    // Whether the fd has been put in the slot yet; the first read does it.
+    bool placed{};
+  };
+  File add(int fd);
+
+  /// One of the registered buffers, or none if they're all in use.
+  class Buffer : boost::noncopyable {
+   public:
+    Buffer(Buffer&& o) noexcept
+        : ring{std::exchange(o.ring, nullptr)}, index{o.index} {}
+    ~Buffer();
+
+    char* data() const noexcept;
+    size_t size() const noexcept { return ring->options.buffer_size; }
+
+   private:
+    friend FileRing;
+    Buffer(FileRing* _ring, unsigned _index) : ring{_ring}, index{_index} {}
+
+    FileRing* ring;
+    unsigned index;
+  };
+  std::optional<Buffer> buffer();
+
+  /// Read up to n bytes (at most buf.size()) of f at offset into buf. A
+  /// buffer has one read at a time.
+  awaitable<size_t> read(File& f, const Buffer& buf, off_t offset, size_t n);
+
+ private:
+  using handler_t = asio::async_result<asio::use_awaitable_t<>,
+                                       void(err, size_t)>::handler_type;
+  // The read into each buffer, if there is one, with user_data index + 1.
+  // Everything else the ring does has user_data 0.
+  struct Read {
+    std::optional<handler_t> handler;
+    asio::cancellation_slot cancel_slot;
+  };
+
+  const Options options;
+  io_context& io;
+  io_uring ring;
+  vector<char> slab;
+  vector<unsigned> free_buffers;
+  vector<Read> reads;
+  vector<int> free_files;
+  // Where the FILES_UPDATE that puts an fd in a slot reads it from.
+  vector<int> slot_fds;
+  // And the one that empties a slot.
+  int no_fd{-1};
+  // Reset once reap() is done with it, so it never outlives the io_context.
+  std::optional<asio::posix::stream_descriptor> events;
+  size_t in_flight{};
+  bool flush_posted{};
+  bool closing{};
+
+  io_uring_sqe* get_sqe();
+  void flush_later();
+  void cancel(uint64_t data);
+  awaitable<void> reap();
+#endif
+};